@@ -160,9 +160,9 @@ struct fuse_conn_info {
 	char     volume_name[CONN_VOLUME_NAME_BYTES]; // for .init() to fill 
 };
 
-// filesysbox sets flags and reads nonseekable for now. 
-// rest is cleared and untouched. "fh_old" and "fh" are
-// safe to be poked by FS.
+// filesysbox sets flags and reads nonseekable, direct_io and
+// keep_cache (V54). rest is cleared and untouched. "fh_old" and
+// "fh" are safe to be poked by FS.
 struct fuse_file_info {
 	int flags;
 	unsigned long fh_old;
@@ -181,6 +181,8 @@ struct fuse_file_info {
 #define FBXF_ENABLE_DISK_CHANGE_DETECTION 2 // set to enable disk change detection
 #define FBXF_USE_INO                      8 // (V54) filesystem sets st_ino
 #define FBXF_USE_FILL_DIR_STAT            16 // (V54) valid stat data passed to readdir() callback
+#define FBXF_SYNC_ROOT                    32 // (V54) always flush with fsync("/") instead of per file
+#define FBXF_SYNC_PATHS                   64 // (V54) fsync() accepts paths other than "/" with a NULL fi
 
 // tags for FbxSetupFS()
 #define FBXT_FSFLAGS                 (TAG_USER + 1)
@@ -189,9 +191,34 @@ struct fuse_file_info {
 #define FBXT_GET_CONTEXT             (TAG_USER + 4)
 #define FBXT_ACTIVE_UPDATE_TIMEOUT   (TAG_USER + 5) // default: 10000 ms
 #define FBXT_INACTIVE_UPDATE_TIMEOUT (TAG_USER + 6) // default: 500 ms
+#define FBXT_NEGATIVE_LOOKUP_TIMEOUT (TAG_USER + 7) // (V54) default: 0 ms (disabled)
+#define FBXT_ATTR_TIMEOUT            (TAG_USER + 8) // (V54) default: 0 ms (disabled)
+#define FBXT_READ_BUFFER_SIZE        (TAG_USER + 9) // (V54) default: 0 bytes (disabled)
+#define FBXT_WRITE_BUFFER_SIZE       (TAG_USER + 10) // (V54) default: 0 bytes (disabled)
+#define FBXT_BLOCK_CACHE_SIZE        (TAG_USER + 11) // (V54) default: 0 bytes (disabled)
+#define FBXT_READAHEAD_SIZE          (TAG_USER + 12) // (V54) default: 0 bytes (disabled)
+#define FBXT_DIRTY_LIMIT             (TAG_USER + 13) // (V54) default: 0 bytes (disabled)
+#define FBXT_DIR_CACHE_SIZE          (TAG_USER + 14) // (V54) default: 0 bytes (disabled)
+
+// (V54) never expire, only for FBXT_ATTR_TIMEOUT on read-only volumes
+#define FBX_TIMEOUT_INFINITE         0xFFFFFFFFUL
+
+/* (V54) filesysbox private packet type. Copies dp_Arg3 bytes from the
+ * current position of the file handle in dp_Arg1 (fh_Arg1) to the current
+ * position of the file handle in dp_Arg2 (fh_Arg1) on the same volume and
+ * advances both positions. Returns the number of bytes copied, which is
+ * less than dp_Arg3 if the end of the source file is reached, or -1 with
+ * the error code in dp_Res2.
+ */
+#define ACTION_FBX_COPY_FILE_RANGE   0x46425801 // 'FBX' + 1
 
 /* tags for FbxQueryFS() */
 #define FBXT_GMT_OFFSET              (TAG_USER + 101) /* equivalent to TZA_UTCOffset */
+#define FBXT_DIRTY_BYTES             (TAG_USER + 102) /* (V54) bytes written since the last flush */
+#define FBXT_WRITE_RATE              (TAG_USER + 103) /* (V54) average write rate in bytes per second */
+#define FBXT_THRESHOLD_FLUSHES       (TAG_USER + 104) /* (V54) flushes because of FBXT_DIRTY_LIMIT */
+#define FBXT_AGE_FLUSHES             (TAG_USER + 105) /* (V54) flushes because of FBXT_ACTIVE_UPDATE_TIMEOUT */
+#define FBXT_IDLE_FLUSHES            (TAG_USER + 106) /* (V54) flushes because of FBXT_INACTIVE_UPDATE_TIMEOUT */
 
 typedef STDARGS int (*fuse_fill_dir_t) (void *udata, const char *fsname, const struct fbx_stat *stbuf, fbx_off_t off);
 
@@ -203,6 +230,34 @@ typedef void *fuse_dirfil_t;
 #define fuse_loop(fs) FbxEventLoop(fs)
 #define fuse_destroy(fs) FbxCleanupFS(fs)
 
+// (V54) scatter/gather buffer vector for read_buf() and write_buf().
+// buf[] has room for count segments, which may be more than one.
+struct fbx_buf {
+	size_t  size;
+	void   *mem;
+};
+
+struct fbx_bufvec {
+	size_t         count;
+	struct fbx_buf buf[1];
+};
+
+// (V54) mode flags for fallocate(), same values as in Linux
+#define FBX_FALLOC_KEEP_SIZE  0x01 // don't change the file size
+#define FBX_FALLOC_PUNCH_HOLE 0x02 // deallocate range, always with FBX_FALLOC_KEEP_SIZE
+
+// (V54) name filter for readdir_filter(). Names that don't match it may be
+// left out, but filesysbox still matches every name it is given against the
+// full pattern, so the filter may be applied partly or not at all.
+struct fbx_dir_filter {
+	unsigned int flags; // FBX_DIRFILTER_XXX
+	const char  *glob; // whole name, with '*' for any string and '?' for any character
+	const char  *prefix; // names start with this ("" if any)
+	const char  *suffix; // names end with this ("" if any)
+};
+
+#define FBX_DIRFILTER_NOCASE 0x01 // compare ASCII letters case-insensitively
+
 struct FbxFS;
 
 struct fuse_context {
@@ -260,6 +315,14 @@ struct fuse_operations {
 	STDARGS int (*bmap) (const char *, size_t blocksize, UQUAD *idx);
 	STDARGS int (*format) (const char *, ULONG);
 	STDARGS int (*relabel) (const char *);
+	STDARGS int (*getamigaattr) (const char *, struct fbx_stat *, ULONG *, char *, size_t); // (V54)
+	STDARGS int (*read_buf) (const char *, struct fbx_bufvec *, size_t, fbx_off_t, struct fuse_file_info *); // (V54)
+	STDARGS int (*write_buf) (const char *, const struct fbx_bufvec *, fbx_off_t, struct fuse_file_info *); // (V54)
+	STDARGS int (*fallocate) (const char *, int, fbx_off_t, fbx_off_t, struct fuse_file_info *); // (V54)
+	STDARGS int (*copy_file_range) (const char *, struct fuse_file_info *, fbx_off_t,
+		const char *, struct fuse_file_info *, fbx_off_t, size_t, int); // (V54)
+	STDARGS int (*readdir_filter) (const char *, void *, fuse_fill_dir_t, fbx_off_t,
+		const struct fbx_dir_filter *, struct fuse_file_info *); // (V54)
 };
 
 typedef STDARGS void (*FbxSignalCallbackFunc)(ULONG matching_signals);
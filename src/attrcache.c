@@ -0,0 +1,149 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+#include "fuse_stubs.h"
+#include <string.h>
+
+/* Attribute cache. Each entry can hold a copy of the fbx_stat data last
+ * returned by getattr() or fgetattr() for it, as well as its amiga
+ * protection flags and comment, which are used for fs->attrtimeout
+ * milliseconds. Operations that change the attributes of an object
+ * through filesysbox invalidate the copy.
+ */
+
+static BOOL FbxCacheTimeValid(struct FbxFS *fs, ULONG time) {
+	if (fs->attrtimeout == FBX_TIMEOUT_INFINITE) {
+		if (fs->currvol->vflags & FBXVF_READ_ONLY)
+			return TRUE;
+		return (FbxGetUpTimeMillis(fs) - time) < ATTR_TIMEOUT_MILLIS;
+	}
+
+	return (FbxGetUpTimeMillis(fs) - time) < fs->attrtimeout;
+}
+
+static BOOL FbxEntryAttrValid(struct FbxFS *fs, struct FbxEntry *e) {
+	return e->statvalid && FbxCacheTimeValid(fs, e->stattime);
+}
+
+int FbxGetEntryAttr(struct FbxFS *fs, struct FbxEntry *e, struct fbx_stat *stat,
+	struct fuse_file_info *fi)
+{
+	int error;
+
+	if (FbxEntryAttrValid(fs, e)) {
+		DEBUGF("FbxGetEntryAttr: using cached attributes for '%s'\n", e->path);
+		memcpy(stat, &e->statbuf, sizeof(*stat));
+		return 0;
+	}
+
+	FbxFlushWriteBuffers(fs, e);
+
+	if (fi != NULL)
+		error = Fbx_fgetattr(fs, e->path, stat, fi);
+	else
+		error = Fbx_getattr(fs, e->path, stat);
+	if (error == 0) {
+		FbxSetEntryAttr(fs, e, stat);
+	}
+
+	return error;
+}
+
+int FbxGetPathAttr(struct FbxFS *fs, const char *path, struct fbx_stat *stat) {
+	struct FbxEntry *e;
+
+	e = FbxFindEntry(fs, path);
+	if (e != NULL)
+		return FbxGetEntryAttr(fs, e, stat, NULL);
+
+	return FbxCachedGetAttr(fs, path, stat);
+}
+
+void FbxSetEntryAttr(struct FbxFS *fs, struct FbxEntry *e, const struct fbx_stat *stat) {
+	if (fs->attrtimeout == 0)
+		return;
+
+	memcpy(&e->statbuf, stat, sizeof(*stat));
+	e->stattime  = FbxGetUpTimeMillis(fs);
+	e->statvalid = TRUE;
+}
+
+/* Returns TRUE if both the stat data and the xattrs of e are cached */
+BOOL FbxEntryAttrsCached(struct FbxFS *fs, struct FbxEntry *e) {
+	return FbxEntryAttrValid(fs, e) && e->xattrvalid && FbxCacheTimeValid(fs, e->xattrtime);
+}
+
+void FbxInvalidateEntryAttr(struct FbxFS *fs, struct FbxEntry *e) {
+	e->statvalid = FALSE;
+}
+
+void FbxInvalidatePathAttr(struct FbxFS *fs, const char *path) {
+	struct FbxEntry *e;
+
+	e = FbxFindEntry(fs, path);
+	if (e != NULL)
+		FbxInvalidateEntryAttr(fs, e);
+
+	FbxInvalidateDirListing(fs, path);
+}
+
+BOOL FbxGetEntryXattrs(struct FbxFS *fs, struct FbxEntry *e, ULONG *prot, char *comment, size_t size) {
+	if (!e->xattrvalid || !FbxCacheTimeValid(fs, e->xattrtime))
+		return FALSE;
+
+	DEBUGF("FbxGetEntryXattrs: using cached xattrs for '%s'\n", e->path);
+	*prot = e->amigaprot;
+	if (comment != NULL)
+		FbxStrlcpy(fs, comment, (e->comment != NULL) ? e->comment : "", size);
+	return TRUE;
+}
+
+void FbxSetEntryXattrs(struct FbxFS *fs, struct FbxEntry *e, ULONG prot, const char *comment) {
+	struct Library *SysBase = fs->sysbase;
+	size_t len;
+
+	FbxInvalidateEntryXattrs(fs, e);
+
+	if (fs->attrtimeout == 0)
+		return;
+
+	len = strlen(comment);
+	if (len != 0) {
+		e->comment = AllocVecPooled(fs->mempool, len + 1);
+		if (e->comment == NULL)
+			return;
+		CopyMem(comment, e->comment, len + 1);
+	}
+
+	e->amigaprot  = prot;
+	e->xattrtime  = FbxGetUpTimeMillis(fs);
+	e->xattrvalid = TRUE;
+}
+
+void FbxInvalidateEntryXattrs(struct FbxFS *fs, struct FbxEntry *e) {
+	struct Library *SysBase = fs->sysbase;
+
+	if (e->comment != NULL) {
+		FreeVecPooled(fs->mempool, e->comment);
+		e->comment = NULL;
+	}
+	e->xattrvalid = FALSE;
+}
+
+void FbxInvalidatePathXattrs(struct FbxFS *fs, const char *path) {
+	struct FbxEntry *e;
+
+	e = FbxFindEntry(fs, path);
+	if (e != NULL)
+		FbxInvalidateEntryXattrs(fs, e);
+
+	FbxInvalidateDirListing(fs, path);
+}
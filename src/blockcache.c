@@ -0,0 +1,286 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+
+/* The block cache holds file data in blocks of BLOCKCACHEBLOCKSIZE bytes
+ * for the current volume. Blocks are shared by all handles to the same
+ * file and outlive them, so that a file which is opened and read again
+ * doesn't need to be read from the file system again. Files are identified
+ * by their diskkey, which is why the cache is only used with FBXF_USE_INO.
+ * When the maximum number of blocks is reached the least recently used
+ * one is replaced.
+ *
+ * Each file with cached blocks has a FbxCachedFile node that keeps the
+ * list of its blocks, so that they can be invalidated without looking
+ * through the whole cache, and the block that holds the end of the file,
+ * which no longer is valid once the file has been extended.
+ */
+
+void FbxInitBlockCache(struct FbxBlockCache *bc, ULONG maxcount) {
+	int i;
+
+	for (i = 0; i < BLOCKCACHEHASHSIZE; i++) {
+		NEWMINLIST(&bc->hashtab[i]);
+		NEWMINLIST(&bc->filetab[i]);
+	}
+	NEWMINLIST(&bc->lrulist);
+	bc->count    = 0;
+	bc->maxcount = maxcount;
+}
+
+/* Returns TRUE if reads through the lock can be served from the block
+ * cache. The file system can bypass the cache for a file by setting
+ * direct_io when opening it.
+ */
+BOOL FbxUseBlockCache(struct FbxFS *fs, struct FbxLock *lock) {
+	if (fs->currvol->blockcache.maxcount == 0)
+		return FALSE;
+
+	if (!(fs->fsflags & FBXF_USE_INO) || lock->entry->diskkey == 0)
+		return FALSE;
+
+	if (lock->info == NULL || lock->info->direct_io)
+		return FALSE;
+
+	return TRUE;
+}
+
+static inline ULONG FbxHashFileId(UQUAD id) {
+	return (ULONG)id ^ (ULONG)(id >> 32);
+}
+
+static inline ULONG FbxHashBlock(UQUAD id, UQUAD index) {
+	return FbxHashFileId(id) * 31 + (ULONG)index;
+}
+
+static struct FbxCachedFile *FbxFindCachedFile(struct FbxBlockCache *bc, UQUAD id) {
+	struct MinNode *chain, *succ;
+	struct FbxCachedFile *cf;
+
+	for (chain = bc->filetab[FbxHashFileId(id) % BLOCKCACHEHASHSIZE].mlh_Head;
+	     (succ = chain->mln_Succ) != NULL;
+	     chain = succ)
+	{
+		cf = FSCACHEDFILEFROMHASHCHAIN(chain);
+		if (cf->id == id)
+			return cf;
+	}
+
+	return NULL;
+}
+
+struct FbxBlock *FbxFindBlock(struct FbxFS *fs, UQUAD id, UQUAD index) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+	struct MinNode *chain, *succ;
+	struct FbxBlock *block;
+
+	if (bc->count == 0)
+		return NULL;
+
+	for (chain = bc->hashtab[FbxHashBlock(id, index) % BLOCKCACHEHASHSIZE].mlh_Head;
+	     (succ = chain->mln_Succ) != NULL;
+	     chain = succ)
+	{
+		block = FSBLOCKFROMHASHCHAIN(chain);
+		if (block->index == index && block->file->id == id) {
+			// move to end of LRU list
+			Remove((struct Node *)&block->lruchain);
+			AddTail((struct List *)&bc->lrulist, (struct Node *)&block->lruchain);
+			return block;
+		}
+	}
+
+	return NULL;
+}
+
+/* Unlinks a block from the cache without freeing it */
+static void FbxUnlinkBlock(struct FbxFS *fs, struct FbxBlock *block) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+
+	Remove((struct Node *)&block->hashchain);
+	Remove((struct Node *)&block->lruchain);
+	Remove((struct Node *)&block->filechain);
+	bc->count--;
+
+	if (block->file->eofblock == block)
+		block->file->eofblock = NULL;
+}
+
+static void FbxFreeCachedFileIfEmpty(struct FbxFS *fs, struct FbxCachedFile *cf) {
+	struct Library *SysBase = fs->sysbase;
+
+	if (IsMinListEmpty(&cf->blocks)) {
+		Remove((struct Node *)&cf->hashchain);
+		FreeVecPooled(fs->mempool, cf);
+	}
+}
+
+static void FbxRemoveBlock(struct FbxFS *fs, struct FbxBlock *block) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxCachedFile *cf = block->file;
+
+	FbxUnlinkBlock(fs, block);
+	FreeVecPooled(fs->mempool, block);
+	FbxFreeCachedFileIfEmpty(fs, cf);
+}
+
+/* Returns a block to be filled in and passed to FbxInsertBlock() or
+ * freed with FbxFreeBlock(). If the cache is full the least recently
+ * used block is reused.
+ */
+struct FbxBlock *FbxAllocBlock(struct FbxFS *fs) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+	struct FbxCachedFile *cf;
+	struct FbxBlock *block;
+
+	if (bc->maxcount == 0)
+		return NULL;
+
+	if (bc->count >= bc->maxcount) {
+		block = FSBLOCKFROMLRUCHAIN(bc->lrulist.mlh_Head);
+		cf = block->file;
+		FbxUnlinkBlock(fs, block);
+		FbxFreeCachedFileIfEmpty(fs, cf);
+		return block;
+	}
+
+	return AllocVecPooled(fs->mempool, sizeof(*block));
+}
+
+void FbxFreeBlock(struct FbxFS *fs, struct FbxBlock *block) {
+	struct Library *SysBase = fs->sysbase;
+
+	FreeVecPooled(fs->mempool, block);
+}
+
+/* Adds a block holding len bytes of the file at index * BLOCKCACHEBLOCKSIZE.
+ * A block with less than BLOCKCACHEBLOCKSIZE bytes ends at the end of file.
+ * Returns FALSE if the block could not be added, in which case it has been
+ * freed.
+ */
+BOOL FbxInsertBlock(struct FbxFS *fs, struct FbxBlock *block, UQUAD id, UQUAD index, LONG len) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+	struct FbxCachedFile *cf;
+	struct FbxBlock *old;
+
+	old = FbxFindBlock(fs, id, index);
+	if (old != NULL)
+		FbxRemoveBlock(fs, old);
+
+	cf = FbxFindCachedFile(bc, id);
+	if (cf != NULL && cf->eofblock != NULL &&
+		(len < BLOCKCACHEBLOCKSIZE || index > cf->eofblock->index))
+	{
+		// the end of file has moved
+		FbxRemoveBlock(fs, cf->eofblock);
+		cf = FbxFindCachedFile(bc, id);
+	}
+	if (cf == NULL) {
+		cf = AllocVecPooled(fs->mempool, sizeof(*cf));
+		if (cf == NULL) {
+			FreeVecPooled(fs->mempool, block);
+			return FALSE;
+		}
+		NEWMINLIST(&cf->blocks);
+		cf->id       = id;
+		cf->eofblock = NULL;
+		AddTail((struct List *)&bc->filetab[FbxHashFileId(id) % BLOCKCACHEHASHSIZE], (struct Node *)&cf->hashchain);
+	}
+
+	block->file  = cf;
+	block->index = index;
+	block->len   = len;
+
+	if (len < BLOCKCACHEBLOCKSIZE)
+		cf->eofblock = block;
+
+	AddTail((struct List *)&bc->hashtab[FbxHashBlock(id, index) % BLOCKCACHEHASHSIZE], (struct Node *)&block->hashchain);
+	AddTail((struct List *)&bc->lrulist, (struct Node *)&block->lruchain);
+	AddTail((struct List *)&cf->blocks, (struct Node *)&block->filechain);
+	bc->count++;
+	return TRUE;
+}
+
+/* Removes all blocks of the file from offset onwards. Must be called when
+ * the file is truncated, deleted or may have been changed by others.
+ */
+void FbxInvalidateBlocks(struct FbxFS *fs, UQUAD id, QUAD offset) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+	struct MinNode *chain, *succ;
+	struct FbxCachedFile *cf;
+	struct FbxBlock *block;
+	UQUAD index;
+
+	if (bc->count == 0)
+		return;
+
+	cf = FbxFindCachedFile(bc, id);
+	if (cf == NULL)
+		return;
+
+	index = offset / BLOCKCACHEBLOCKSIZE;
+	for (chain = cf->blocks.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		block = FSBLOCKFROMFILECHAIN(chain);
+		if (block->index >= index) {
+			FbxUnlinkBlock(fs, block);
+			FreeVecPooled(fs->mempool, block);
+		}
+	}
+
+	FbxFreeCachedFileIfEmpty(fs, cf);
+}
+
+/* Removes the blocks of the file that overlap with data that has been
+ * written, and the end of file block if the file may have been extended.
+ */
+void FbxInvalidateBlockRange(struct FbxFS *fs, UQUAD id, QUAD offset, QUAD len) {
+	struct FbxBlockCache *bc = &fs->currvol->blockcache;
+	struct FbxCachedFile *cf;
+	struct FbxBlock *block;
+	UQUAD index, last;
+
+	if (bc->count == 0 || len <= 0)
+		return;
+
+	cf = FbxFindCachedFile(bc, id);
+	if (cf == NULL)
+		return;
+
+	index = offset / BLOCKCACHEBLOCKSIZE;
+	last  = (offset + len - 1) / BLOCKCACHEBLOCKSIZE;
+	if ((last - index) >= bc->count) {
+		FbxInvalidateBlocks(fs, id, offset);
+		return;
+	}
+
+	block = cf->eofblock;
+	if (block != NULL && (offset + len) > (block->index * BLOCKCACHEBLOCKSIZE + block->len))
+		FbxRemoveBlock(fs, block); // may free cf
+
+	for (; index <= last; index++) {
+		block = FbxFindBlock(fs, id, index);
+		if (block != NULL)
+			FbxRemoveBlock(fs, block);
+	}
+}
+
+void FbxFlushBlockCache(struct FbxFS *fs, struct FbxBlockCache *bc) {
+	struct MinNode *chain;
+
+	while ((chain = bc->lrulist.mlh_Head)->mln_Succ != NULL) {
+		FbxRemoveBlock(fs, FSBLOCKFROMLRUCHAIN(chain));
+	}
+}
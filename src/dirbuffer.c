@@ -0,0 +1,195 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+#include <string.h>
+
+/* A directory buffer holds variable length records packed one after the
+ * other into large chunks allocated from the lock's memory pool, so that
+ * adding an entry usually is only a matter of bumping the used count of
+ * the last chunk. Records are read back in order, and stay valid until
+ * FbxReleaseDirData() is called, which frees the chunks that have been
+ * read completely and starts over in the one being read if it has been
+ * used up.
+ */
+
+void FbxInitDirBuffer(struct FbxDirBuffer *db) {
+	NEWMINLIST(&db->chunks);
+	db->readchunk = NULL;
+	db->readpos   = 0;
+	db->count     = 0;
+}
+
+/* Returns size bytes of memory in the buffer, aligned to DIRDATAALIGN */
+APTR FbxAllocDirBuffer(struct FbxLock *lock, struct FbxDirBuffer *db, ULONG size) {
+	struct Library *SysBase = lock->fs->sysbase;
+	struct FbxDirChunk *chunk = NULL;
+	ULONG chunksize;
+	APTR ptr;
+
+	size = (size + DIRDATAALIGN - 1) & ~(DIRDATAALIGN - 1);
+
+	if (!IsMinListEmpty(&db->chunks))
+		chunk = (struct FbxDirChunk *)db->chunks.mlh_TailPred;
+
+	if (chunk == NULL || (chunk->size - chunk->used) < size) {
+		chunksize = max(size, DIRCHUNKSIZE);
+		chunk = AllocVecPooled(lock->mempool, sizeof(*chunk) + chunksize);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->size = chunksize;
+		chunk->used = 0;
+		AddTail((struct List *)&db->chunks, (struct Node *)&chunk->node);
+	}
+
+	ptr = (UBYTE *)(chunk + 1) + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+/* Adds a record for a directory entry. Only the parts of the stat data that
+ * are used for directory entries are kept, and only if stat is not NULL.
+ * If comment is not NULL the protection flags and the comment are kept too,
+ * which requires stat data.
+ */
+struct FbxDirData *FbxAddDirData(struct FbxLock *lock, struct FbxDirBuffer *db, const char *name,
+	const struct fbx_stat *stat, ULONG prot, const char *comment)
+{
+	struct FbxDirData *dd;
+	struct FbxDirStat *ds;
+	size_t namesize = strlen(name) + 1;
+	size_t commentsize = 0;
+	ULONG nameoffset;
+
+	nameoffset = sizeof(*dd);
+	if (stat != NULL) {
+		nameoffset += sizeof(*ds);
+		if (comment != NULL)
+			commentsize = strlen(comment) + 1;
+	}
+
+	dd = FbxAllocDirBuffer(lock, db, nameoffset + namesize + commentsize);
+	if (dd == NULL)
+		return NULL;
+
+	dd->reclen     = (nameoffset + namesize + commentsize + DIRDATAALIGN - 1) & ~(DIRDATAALIGN - 1);
+	dd->nameoffset = nameoffset;
+	dd->flags      = 0;
+
+	if (stat != NULL) {
+		ds = DIRDATASTAT(dd);
+		ds->ino    = stat->st_ino;
+		ds->size   = stat->st_size;
+		ds->blocks = stat->st_blocks;
+		ds->mtim   = stat->st_mtim;
+		ds->mode   = stat->st_mode;
+		ds->uid    = stat->st_uid;
+		ds->gid    = stat->st_gid;
+		ds->prot   = prot;
+		dd->flags |= DIRDATAF_STAT;
+	}
+
+	memcpy(DIRDATANAME(dd), name, namesize);
+
+	if (commentsize != 0) {
+		memcpy(DIRDATANAME(dd) + namesize, comment, commentsize);
+		dd->flags |= DIRDATAF_ATTRS;
+	}
+
+	db->count++;
+	return dd;
+}
+
+/* Advances to the first chunk with unread records. Returns FALSE if all
+ * records have been read.
+ */
+static BOOL FbxSeekDirData(struct FbxDirBuffer *db) {
+	struct MinNode *next;
+
+	if (db->readchunk == NULL) {
+		if (IsMinListEmpty(&db->chunks))
+			return FALSE;
+		db->readchunk = (struct FbxDirChunk *)db->chunks.mlh_Head;
+		db->readpos   = 0;
+	}
+
+	while (db->readpos >= db->readchunk->used) {
+		next = db->readchunk->node.mln_Succ;
+		if (next->mln_Succ == NULL)
+			return FALSE;
+		db->readchunk = (struct FbxDirChunk *)next;
+		db->readpos   = 0;
+	}
+
+	return TRUE;
+}
+
+/* Returns the next record, or NULL if all have been read */
+struct FbxDirData *FbxNextDirData(struct FbxDirBuffer *db) {
+	struct FbxDirData *dd;
+
+	if (!FbxSeekDirData(db))
+		return NULL;
+
+	dd = (struct FbxDirData *)((UBYTE *)(db->readchunk + 1) + db->readpos);
+	db->readpos += dd->reclen;
+	return dd;
+}
+
+BOOL FbxDirBufferEmpty(struct FbxDirBuffer *db) {
+	return !FbxSeekDirData(db);
+}
+
+/* Frees the records that have been read. Pointers to them must no longer
+ * be in use.
+ */
+void FbxReleaseDirData(struct FbxLock *lock, struct FbxDirBuffer *db) {
+	struct Library *SysBase = lock->fs->sysbase;
+	struct FbxDirChunk *chunk;
+
+	if (db->readchunk == NULL)
+		return;
+
+	while ((chunk = (struct FbxDirChunk *)db->chunks.mlh_Head) != db->readchunk) {
+		Remove((struct Node *)&chunk->node);
+		FreeVecPooled(lock->mempool, chunk);
+	}
+
+	if (db->readpos >= chunk->used) {
+		// everything has been read, reuse the chunk
+		chunk->used = 0;
+		db->readpos = 0;
+	}
+}
+
+void FbxFreeDirBuffer(struct FbxLock *lock, struct FbxDirBuffer *db) {
+#ifdef __AROS__
+	extern struct Library *SysBase;
+#endif
+	struct MinNode *chain, *succ;
+
+	for (chain = db->chunks.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		FreeVecPooled(lock->mempool, chain);
+	}
+
+	FbxInitDirBuffer(db);
+}
+
+void FbxDirStat2Stat(const struct FbxDirStat *ds, struct fbx_stat *stat) {
+	memset(stat, 0, sizeof(*stat));
+	stat->st_ino    = ds->ino;
+	stat->st_size   = ds->size;
+	stat->st_blocks = ds->blocks;
+	stat->st_mtim   = ds->mtim;
+	stat->st_mode   = ds->mode;
+	stat->st_uid    = ds->uid;
+	stat->st_gid    = ds->gid;
+}
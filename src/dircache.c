@@ -0,0 +1,246 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+#include <string.h>
+
+/* The directory cache keeps the complete listings of directories of the
+ * current volume, with the stat data, protection flags and comment of each
+ * entry, so that scanning a directory again doesn't need any calls to the
+ * file system. A listing is collected by ExNext() or ExAll() while they go
+ * through the directory, and only added to the cache if every entry was
+ * examined and nothing was changed through filesysbox in the meantime.
+ *
+ * Changes to an object invalidate the listing of its parent directory, and
+ * creating, deleting or renaming it also the listing of the grandparent,
+ * as the date of the parent has changed. The size of the cache is bounded
+ * by maxsize, and the least recently used listings are dropped to make
+ * room for new ones.
+ */
+
+void FbxInitDirCache(struct FbxDirCache *dc, ULONG maxsize) {
+	int i;
+
+	for (i = 0; i < DIRCACHEHASHSIZE; i++) {
+		NEWMINLIST(&dc->hashtab[i]);
+	}
+	NEWMINLIST(&dc->lrulist);
+	dc->size       = 0;
+	dc->maxsize    = maxsize;
+	dc->generation = 0;
+}
+
+static inline ULONG FbxDirListingSize(struct FbxDirListing *dl) {
+	return sizeof(*dl) + dl->size + strlen(dl->path) + 1;
+}
+
+static struct FbxDirListing *FbxFindDirListing(struct FbxFS *fs, struct FbxDirCache *dc,
+	const char *path)
+{
+	struct Library *SysBase = fs->sysbase;
+	struct MinNode *chain, *succ;
+	struct FbxDirListing *dl;
+	ULONG hash;
+
+	if (IsMinListEmpty(&dc->lrulist))
+		return NULL;
+
+	hash = FbxHashPath(fs, path);
+	for (chain = dc->hashtab[hash % DIRCACHEHASHSIZE].mlh_Head;
+	     (succ = chain->mln_Succ) != NULL;
+	     chain = succ)
+	{
+		dl = FSDIRLISTINGFROMHASHCHAIN(chain);
+		if (dl->hash == hash && FbxStrcmp(fs, dl->path, path) == 0) {
+			// move to end of LRU list
+			Remove((struct Node *)&dl->lruchain);
+			AddTail((struct List *)&dc->lrulist, (struct Node *)&dl->lruchain);
+			return dl;
+		}
+	}
+
+	return NULL;
+}
+
+static void FbxRemoveDirListing(struct FbxFS *fs, struct FbxDirCache *dc, struct FbxDirListing *dl) {
+	struct Library *SysBase = fs->sysbase;
+
+	Remove((struct Node *)&dl->hashchain);
+	Remove((struct Node *)&dl->lruchain);
+	dc->size -= FbxDirListingSize(dl);
+	FreeVecPooled(fs->mempool, dl);
+}
+
+static void FbxRemoveDirListingPath(struct FbxFS *fs, struct FbxDirCache *dc, const char *path) {
+	struct FbxDirListing *dl;
+
+	dl = FbxFindDirListing(fs, dc, path);
+	if (dl != NULL)
+		FbxRemoveDirListing(fs, dc, dl);
+}
+
+/* Copies the cached listing of the directory of the lock to lock->dirbuf.
+ * Returns FALSE if there is none.
+ */
+BOOL FbxGetDirListing(struct FbxFS *fs, struct FbxLock *lock) {
+	struct FbxDirListing *dl;
+	APTR buf;
+
+	dl = FbxFindDirListing(fs, &fs->currvol->dircache, lock->entry->path);
+	if (dl == NULL)
+		return FALSE;
+
+	DEBUGF("FbxGetDirListing: using cached listing for '%s'\n", dl->path);
+
+	if (dl->size != 0) {
+		// the records are already aligned, so they can be copied as one block
+		buf = FbxAllocDirBuffer(lock, &lock->dirbuf, dl->size);
+		if (buf == NULL)
+			return FALSE;
+		memcpy(buf, dl + 1, dl->size);
+	}
+
+	return TRUE;
+}
+
+/* Starts collecting the listing of the directory that is about to be read */
+void FbxStartDirListing(struct FbxFS *fs, struct FbxLock *lock) {
+	struct FbxDirCache *dc = &fs->currvol->dircache;
+
+	lock->dirlisting = (dc->maxsize != 0);
+	lock->dirgen     = dc->generation;
+}
+
+void FbxAddDirListingEntry(struct FbxFS *fs, struct FbxLock *lock, const char *name,
+	const struct fbx_stat *stat, ULONG prot, const char *comment)
+{
+	if (!lock->dirlisting)
+		return;
+
+	if (FbxAddDirData(lock, &lock->dirlist, name, stat, prot, comment) == NULL)
+		FbxEndDirListing(lock);
+}
+
+/* Adds the collected listing to the cache once the directory has been
+ * read to the end. It is only used if a record was added for every entry
+ * that was read, and if there have been no changes since the directory
+ * was read.
+ */
+void FbxFinishDirListing(struct FbxFS *fs, struct FbxLock *lock) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxDirCache *dc = &fs->currvol->dircache;
+	struct MinNode *chain, *succ;
+	struct FbxDirListing *dl;
+	const char *path = lock->entry->path;
+	ULONG size = 0, memsize;
+	UBYTE *dst;
+
+	if (!lock->dirlisting)
+		return;
+
+	if (lock->dirlist.count != lock->dirbuf.count || lock->dirgen != dc->generation) {
+		FbxEndDirListing(lock);
+		return;
+	}
+
+	for (chain = lock->dirlist.chunks.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		size += ((struct FbxDirChunk *)chain)->used;
+	}
+
+	memsize = sizeof(*dl) + size + strlen(path) + 1;
+	if (memsize > dc->maxsize) {
+		FbxEndDirListing(lock);
+		return;
+	}
+
+	FbxRemoveDirListingPath(fs, dc, path);
+
+	while ((dc->size + memsize) > dc->maxsize) {
+		FbxRemoveDirListing(fs, dc, FSDIRLISTINGFROMLRUCHAIN(dc->lrulist.mlh_Head));
+	}
+
+	dl = AllocVecPooled(fs->mempool, memsize);
+	if (dl != NULL) {
+		dst = (UBYTE *)(dl + 1);
+		for (chain = lock->dirlist.chunks.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+			struct FbxDirChunk *chunk = (struct FbxDirChunk *)chain;
+			memcpy(dst, chunk + 1, chunk->used);
+			dst += chunk->used;
+		}
+
+		dl->path = (char *)dst;
+		strcpy(dl->path, path);
+		dl->hash = FbxHashPath(fs, path);
+		dl->size = size;
+
+		AddTail((struct List *)&dc->hashtab[dl->hash % DIRCACHEHASHSIZE], (struct Node *)&dl->hashchain);
+		AddTail((struct List *)&dc->lrulist, (struct Node *)&dl->lruchain);
+		dc->size += memsize;
+	}
+
+	FbxEndDirListing(lock);
+}
+
+void FbxEndDirListing(struct FbxLock *lock) {
+	FbxFreeDirBuffer(lock, &lock->dirlist);
+	lock->dirlisting = FALSE;
+}
+
+/* Must be called when the object at path has been changed */
+void FbxInvalidateDirListing(struct FbxFS *fs, const char *path) {
+	struct FbxDirCache *dc = &fs->currvol->dircache;
+	char pathbuf[FBX_MAX_PATH];
+
+	dc->generation++;
+
+	if (IsMinListEmpty(&dc->lrulist))
+		return;
+
+	FbxStrlcpy(fs, pathbuf, path, FBX_MAX_PATH);
+	if (FbxParentPath(fs, pathbuf))
+		FbxRemoveDirListingPath(fs, dc, pathbuf);
+}
+
+/* Must be called when the object at path has been created, deleted or
+ * renamed. Listings of directories below it are dropped as well.
+ */
+void FbxInvalidateDirListingTree(struct FbxFS *fs, const char *path) {
+	struct FbxDirCache *dc = &fs->currvol->dircache;
+	struct MinNode *chain, *succ;
+	struct FbxDirListing *dl;
+	char pathbuf[FBX_MAX_PATH];
+
+	dc->generation++;
+
+	if (IsMinListEmpty(&dc->lrulist))
+		return;
+
+	for (chain = dc->lrulist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		dl = FSDIRLISTINGFROMLRUCHAIN(chain);
+		if (FbxStrcmp(fs, dl->path, path) == 0 || FbxIsParent(fs, path, dl->path))
+			FbxRemoveDirListing(fs, dc, dl);
+	}
+
+	FbxStrlcpy(fs, pathbuf, path, FBX_MAX_PATH);
+	if (FbxParentPath(fs, pathbuf)) {
+		FbxRemoveDirListingPath(fs, dc, pathbuf);
+		// the date of the parent directory has changed
+		if (FbxParentPath(fs, pathbuf))
+			FbxRemoveDirListingPath(fs, dc, pathbuf);
+	}
+}
+
+void FbxFlushDirCache(struct FbxFS *fs, struct FbxDirCache *dc) {
+	struct MinNode *chain;
+
+	while ((chain = dc->lrulist.mlh_Head)->mln_Succ != NULL) {
+		FbxRemoveDirListing(fs, dc, FSDIRLISTINGFROMLRUCHAIN(chain));
+	}
+}
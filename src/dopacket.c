@@ -196,6 +196,10 @@ SIPTR FbxDoPacket(struct FbxFS *fs, struct DosPacket *pkt) {
 	case ACTION_FREE_DISK_FSSM:
 		r1 = FbxReleaseFSSM(fs, (struct FileSysStartupMsg *)pkt->dp_Arg1);
 		break;
+	case ACTION_FBX_COPY_FILE_RANGE:
+		r1 = FbxCopyFileRange(fs, (struct FbxLock *)BADDR(pkt->dp_Arg1),
+			(struct FbxLock *)BADDR(pkt->dp_Arg2), pkt->dp_Arg3);
+		break;
 	case ACTION_NIL:
 		r1 = DOSFALSE;
 		fs->r2 = 0;
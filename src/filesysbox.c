@@ -113,69 +113,220 @@ size_t FbxStrlcat(struct FbxFS *fs, char *dst, const char *src, size_t dst_size)
 	return utf8_strlcat(dst, src, dst_size);
 }
 
-static IPTR FbxHashPathInoCase(struct FbxFS *fs, const char *str) {
-	IPTR v = 0;
-	ULONG c;
+/* Per-character mixing step, every input bit affects the whole state so
+ * that long paths sharing a common prefix still spread out well.
+ */
+static inline ULONG FbxHashMix(ULONG h, ULONG c) {
+	h ^= c;
+	h *= 0x5bd1e995;
+	h ^= h >> 15;
+	return h;
+}
 
-	DEBUGF("FbxHashPathInoCase(%p, '%s')\n", fs, str);
+/* Final avalanche (fmix32 from MurmurHash3) */
+static inline ULONG FbxHashFinal(ULONG h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+#define FBX_HASH_SEED 0x811c9dc5
+
+static ULONG FbxHashPathCase(struct FbxFS *fs, const char *str) {
+	ULONG h = FBX_HASH_SEED;
+	ULONG c;
 
-	// get a small seed from number of characters
-	v = FbxCharCount(fs, str);
+	DEBUGF("FbxHashPathCase(%p, '%s')\n", fs, str);
 
-	// compute hash
 	while ((c = utf8_decode_fast(&str)) != '\0') {
-		v = v * 13 + c;
+		h = FbxHashMix(h, c);
 	}
 
-	return v;
+	return FbxHashFinal(h);
 }
 
-static IPTR FbxHashPathInoNoCase(struct FbxFS *fs, const char *str) {
-	IPTR v = 0;
+static ULONG FbxHashPathNoCase(struct FbxFS *fs, const char *str) {
+	ULONG h = FBX_HASH_SEED;
 	ULONG c;
 
-	DEBUGF("FbxHashPathInoNoCase(%p, '%s')\n", fs, str);
+	DEBUGF("FbxHashPathNoCase(%p, '%s')\n", fs, str);
 
-	// get a small seed from number of characters
-	v = FbxCharCount(fs, str);
-
-	// compute hash
 	while ((c = utf8_decode_fast(&str)) != '\0') {
 		c = ucs4_toupper(c);
-		v = v * 13 + c;
+		h = FbxHashMix(h, c);
 	}
 
-	return v;
+	return FbxHashFinal(h);
+}
+
+ULONG FbxHashPath(struct FbxFS *fs, const char *str) {
+	if (fs->currvol->vflags & FBXVF_CASE_SENSITIVE)
+		return FbxHashPathCase(fs, str);
+	else
+		return FbxHashPathNoCase(fs, str);
 }
 
 IPTR FbxHashPathIno(struct FbxFS *fs, const char *str) {
 	DEBUGF("FbxHashPathIno(%p, '%s')\n", fs, str);
 
-	if (fs->currvol->vflags & FBXVF_CASE_SENSITIVE)
-		return FbxHashPathInoCase(fs, str);
-	else
-		return FbxHashPathInoNoCase(fs, str);
+	return FbxHashPath(fs, str);
 }
 
-/* Same as FbxHashPathIno() but with excess bits masked out */
-static unsigned int FbxHashPath(struct FbxFS *fs, const char *str) {
-	return FbxHashPathIno(fs, str) & ENTRYHASHMASK;
+static struct MinList *FbxAllocEntryTab(struct FbxFS *fs, ULONG size) {
+	struct Library *SysBase = fs->sysbase;
+	struct MinList *tab;
+	ULONG i;
+
+	tab = AllocMem(size * sizeof(struct MinList), MEMF_PUBLIC);
+	if (tab != NULL) {
+		for (i = 0; i < size; i++) {
+			NEWMINLIST(&tab[i]);
+		}
+	}
+
+	return tab;
 }
 
-struct FbxEntry *FbxFindEntry(struct FbxFS *fs, const char *path) {
+static void FbxFreeEntryTab(struct FbxFS *fs, struct MinList *tab, ULONG size) {
+	struct Library *SysBase = fs->sysbase;
+
+	FreeMem(tab, size * sizeof(struct MinList));
+}
+
+static void FbxInsertEntry(struct FbxFS *fs, struct FbxVolume *vol, struct FbxEntry *e) {
+	struct Library *SysBase = fs->sysbase;
+	ULONG i;
+
+	i = e->hash & vol->entrymask;
+	AddTail((struct List *)&vol->entrytab[i], (struct Node *)&e->hashchain);
+}
+
+static void FbxCheckEntryTableSize(struct FbxFS *fs, struct FbxVolume *vol);
+
+/* Moves a few buckets from the old to the new table so that the cost of
+ * resizing is spread out over many operations instead of stalling one.
+ */
+static void FbxRehashStep(struct FbxFS *fs, struct FbxVolume *vol) {
+	struct Library *SysBase = fs->sysbase;
+	struct MinNode *chain;
+	int steps = ENTRYHASHSTEPS;
+	int empty = ENTRYHASHSTEPS * 4;
+
+	while (vol->oldentrytab != NULL && steps > 0 && empty > 0) {
+		struct MinList *bucket = &vol->oldentrytab[vol->rehashidx];
+
+		if (IsMinListEmpty(bucket)) {
+			empty--;
+		} else {
+			while ((chain = (struct MinNode *)RemHead((struct List *)bucket)) != NULL) {
+				FbxInsertEntry(fs, vol, FSENTRYFROMHASHCHAIN(chain));
+			}
+			steps--;
+		}
+
+		if (++vol->rehashidx > vol->oldentrymask) {
+			DEBUGF("FbxRehashStep: resize to %lu buckets done\n", (unsigned long)vol->entrymask + 1);
+			FbxFreeEntryTab(fs, vol->oldentrytab, vol->oldentrymask + 1);
+			vol->oldentrytab = NULL;
+			vol->oldentrymask = 0;
+			vol->rehashidx = 0;
+			FbxCheckEntryTableSize(fs, vol);
+		}
+	}
+}
+
+static void FbxResizeEntryTable(struct FbxFS *fs, struct FbxVolume *vol, ULONG size) {
+	struct MinList *tab;
+
+	/* finish the previous resize first */
+	if (vol->oldentrytab != NULL)
+		return;
+
+	DEBUGF("FbxResizeEntryTable(%p, %p, %lu)\n", fs, vol, (unsigned long)size);
+
+	tab = FbxAllocEntryTab(fs, size);
+	if (tab == NULL) {
+		/* not fatal, we just keep using the current table */
+		return;
+	}
+
+	vol->oldentrytab  = vol->entrytab;
+	vol->oldentrymask = vol->entrymask;
+	vol->rehashidx    = 0;
+	vol->entrytab     = tab;
+	vol->entrymask    = size - 1;
+}
+
+/* Starts a resize if the number of entries has moved outside the limits */
+static void FbxCheckEntryTableSize(struct FbxFS *fs, struct FbxVolume *vol) {
+	ULONG size = vol->entrymask + 1;
+
+	if (vol->numentries > size * ENTRYHASHMAXLOAD) {
+		FbxResizeEntryTable(fs, vol, size * 2);
+	} else if (vol->numentries < size / ENTRYHASHMINLOAD && size > ENTRYHASHSIZE) {
+		FbxResizeEntryTable(fs, vol, size / 2);
+	}
+}
+
+BOOL FbxSetupEntryTable(struct FbxFS *fs, struct FbxVolume *vol) {
+	vol->entrytab = FbxAllocEntryTab(fs, ENTRYHASHSIZE);
+	if (vol->entrytab == NULL)
+		return FALSE;
+
+	vol->entrymask    = ENTRYHASHSIZE - 1;
+	vol->oldentrytab  = NULL;
+	vol->oldentrymask = 0;
+	vol->rehashidx    = 0;
+	vol->numentries   = 0;
+
+	return TRUE;
+}
+
+static void FbxDetachEntries(struct FbxFS *fs, struct MinList *tab, ULONG size) {
+	struct Library *SysBase = fs->sysbase;
+	struct MinNode *chain;
+	ULONG i;
+
+	for (i = 0; i < size; i++) {
+		while ((chain = (struct MinNode *)RemHead((struct List *)&tab[i])) != NULL) {
+			chain->mln_Succ = chain;
+			chain->mln_Pred = chain;
+		}
+	}
+}
+
+/* Called when a volume stops being the current one. Any entries still
+ * referenced by locks or notifications are detached from the table.
+ */
+void FbxCleanupEntryTable(struct FbxFS *fs, struct FbxVolume *vol) {
+	if (vol->oldentrytab != NULL) {
+		FbxDetachEntries(fs, vol->oldentrytab, vol->oldentrymask + 1);
+		FbxFreeEntryTab(fs, vol->oldentrytab, vol->oldentrymask + 1);
+		vol->oldentrytab = NULL;
+	}
+	if (vol->entrytab != NULL) {
+		FbxDetachEntries(fs, vol->entrytab, vol->entrymask + 1);
+		FbxFreeEntryTab(fs, vol->entrytab, vol->entrymask + 1);
+		vol->entrytab = NULL;
+	}
+	vol->numentries = 0;
+}
+
+static struct FbxEntry *FbxFindEntryInBucket(struct FbxFS *fs, struct MinList *bucket,
+	const char *path, ULONG hash)
+{
 	struct MinNode *chain, *succ;
 	struct FbxEntry *e;
-	unsigned int i;
 
-	DEBUGF("FbxFindEntry(%p, '%s')\n", fs, path);
-
-	i = FbxHashPath(fs, path);
-	for (chain = fs->currvol->entrytab[i].mlh_Head;
+	for (chain = bucket->mlh_Head;
 	     (succ = chain->mln_Succ) != NULL;
 	     chain = succ)
 	{
 		e = FSENTRYFROMHASHCHAIN(chain);
-		if (FbxStrcmp(fs, e->path, path) == 0) {
+		if (e->hash == hash && FbxStrcmp(fs, e->path, path) == 0) {
 			return e;
 		}
 	}
@@ -183,6 +334,26 @@ struct FbxEntry *FbxFindEntry(struct FbxFS *fs, const char *path) {
 	return NULL;
 }
 
+struct FbxEntry *FbxFindEntry(struct FbxFS *fs, const char *path) {
+	struct FbxVolume *vol = fs->currvol;
+	struct FbxEntry *e;
+	ULONG hash;
+
+	DEBUGF("FbxFindEntry(%p, '%s')\n", fs, path);
+
+	FbxRehashStep(fs, vol);
+
+	hash = FbxHashPath(fs, path);
+
+	if (vol->oldentrytab != NULL) {
+		e = FbxFindEntryInBucket(fs, &vol->oldentrytab[hash & vol->oldentrymask], path, hash);
+		if (e != NULL)
+			return e;
+	}
+
+	return FbxFindEntryInBucket(fs, &vol->entrytab[hash & vol->entrymask], path, hash);
+}
+
 struct FbxLock *FbxLockEntry(struct FbxFS *fs, struct FbxEntry *e, int mode) {
 	struct Library *SysBase = fs->sysbase;
 	struct FbxLock *lock;
@@ -228,10 +399,38 @@ struct FbxLock *FbxLockEntry(struct FbxFS *fs, struct FbxEntry *e, int mode) {
 	lock->fh         = NULL;
 	lock->mempool    = NULL;
 	lock->dirscan    = FALSE;
+	lock->dirinfo    = NULL;
+	lock->diroffset  = 0;
+	lock->dirchunk   = 0;
+	lock->dirmore    = FALSE;
+	lock->dirfilter  = NULL;
+	lock->dirpath    = NULL;
+	lock->dirpathlen = 0;
+	lock->dirpathgen = 0;
 	lock->filepos    = 0;
 	lock->flags      = 0;
-
-	NEWMINLIST(&lock->dirdatalist);
+	lock->rbuf       = NULL;
+	lock->rbufpos    = 0;
+	lock->rbuflen    = 0;
+	lock->wbuf       = NULL;
+	lock->wbufpos    = 0;
+	lock->wbuflen    = 0;
+	lock->wbuferr    = 0;
+	lock->ranext     = 0;
+	lock->rawindow   = 0;
+	lock->raeof      = FALSE;
+	lock->rabuf      = NULL;
+	lock->rabufpos   = 0;
+	lock->rabuflen   = 0;
+	lock->rachain.mln_Succ = NULL;
+	lock->appendcount  = 0;
+	lock->preallocsize = 0;
+	lock->preallocend  = 0;
+
+	FbxInitDirBuffer(&lock->dirbuf);
+	FbxInitDirBuffer(&lock->dirlist);
+	lock->dirlisting = FALSE;
+	lock->dirgen     = 0;
 
 	AddTail((struct List *)&e->locklist, (struct Node *)&lock->entrychain);
 	AddTail((struct List *)&lock->fsvol->locklist, (struct Node *)&lock->volumechain);
@@ -248,11 +447,25 @@ void FbxEndLock(struct FbxFS *fs, struct FbxLock *lock) {
 
 	Remove((struct Node *)&lock->entrychain);
 	Remove((struct Node *)&lock->volumechain);
+	FbxCancelReadahead(fs, lock);
+	FbxEndReadDir(fs, lock);
 
 	if (lock->mempool != NULL) {
 		DeletePool(lock->mempool);
 	}
 
+	if (lock->rbuf != NULL) {
+		FreeVecPooled(fs->mempool, lock->rbuf);
+	}
+
+	if (lock->wbuf != NULL) {
+		FreeVecPooled(fs->mempool, lock->wbuf);
+	}
+
+	if (lock->rabuf != NULL) {
+		FreeVecPooled(fs->mempool, lock->rabuf);
+	}
+
 	lock->fs = NULL; // invalidate lock
 	lock->info = NULL;
 
@@ -267,13 +480,41 @@ void FbxEndLock(struct FbxFS *fs, struct FbxLock *lock) {
 }
 
 void FbxAddEntry(struct FbxFS *fs, struct FbxEntry *e) {
-	struct Library *SysBase = fs->sysbase;
-	unsigned int i;
+	struct FbxVolume *vol = fs->currvol;
 
 	DEBUGF("FbxAddEntry(%p, %p)\n", fs, e);
 
-	i = FbxHashPath(fs, e->path);
-	AddTail((struct List *)&fs->currvol->entrytab[i], (struct Node *)&e->hashchain);
+	FbxRehashStep(fs, vol);
+
+	FbxInsertEntry(fs, vol, e);
+	vol->numentries++;
+
+	FbxCheckEntryTableSize(fs, vol);
+}
+
+void FbxRemoveEntry(struct FbxFS *fs, struct FbxEntry *e) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxVolume *vol = fs->currvol;
+
+	DEBUGF("FbxRemoveEntry(%p, %p)\n", fs, e);
+
+	if (ENTRYDETACHED(e))
+		return;
+
+	Remove((struct Node *)&e->hashchain);
+	vol->numentries--;
+
+	FbxCheckEntryTableSize(fs, vol);
+}
+
+/* Must be called after the path of an entry has been changed */
+void FbxRehashEntry(struct FbxFS *fs, struct FbxEntry *e) {
+	struct Library *SysBase = fs->sysbase;
+
+	DEBUGF("FbxRehashEntry(%p, %p)\n", fs, e);
+
+	Remove((struct Node *)&e->hashchain);
+	FbxInsertEntry(fs, fs->currvol, e);
 }
 
 static const char *FbxSkipColon(const char *s) {
@@ -281,54 +522,105 @@ static const char *FbxSkipColon(const char *s) {
 	return s2 ? (s2 + 1) : s;
 }
 
+/* Appends name to the path of the lock in a single pass, keeping track of
+ * the length of the path instead of scanning it again for every part.
+ * Each '/' that doesn't end a part refers to the parent directory.
+ */
 BOOL FbxLockName2Path(struct FbxFS *fs, struct FbxLock *lock, const char *name, char *fullpathbuf) {
-	char tname[FBX_MAX_NAME];
-	char *p;
-	size_t len;
+	const char *p;
+	size_t len, namelen;
 
 	RDEBUGF("FbxLockName2Path(%p, '%s', %p)\n", lock, name, fullpathbuf);
 
-	if (lock != NULL)
-		FbxStrlcpy(fs, fullpathbuf, lock->entry->path, FBX_MAX_PATH);
-	else
-		FbxStrlcpy(fs, fullpathbuf, "/", FBX_MAX_PATH);
+	if (lock != NULL) {
+		len = strlen(lock->entry->path);
+		memcpy(fullpathbuf, lock->entry->path, len + 1);
+	} else {
+		len = 1;
+		memcpy(fullpathbuf, "/", len + 1);
+	}
 
 	name = FbxSkipColon(name);
 
 	while (*name != '\0') {
-		while (*name == '/') {
-			if (!FbxParentPath(fs, fullpathbuf)) {
+		if (*name == '/') {
+			if (len == 1) {
+				// can't parent root
 				fullpathbuf[0] = '\0';
 				return FALSE;
 			}
+			while (fullpathbuf[--len] != '/');
+			if (len == 0) len = 1; // leave the root '/' alone
+			fullpathbuf[len] = '\0';
 			name++;
+			continue;
 		}
-		if (*name != '\0') {
-			p = strchr(name, '/');
-			if (p == NULL) p = strchr(name, '\0');
 
-			len = p - name;
-			if (len >= sizeof(tname))
-				return FALSE;
+		for (p = name; *p != '\0' && *p != '/'; p++);
 
-			FbxStrlcpy(fs, tname, name, len + 1);
+		namelen = p - name;
+		if (namelen >= FBX_MAX_NAME)
+			return FALSE;
 
-			if (IsDotOrDotDot(tname))
-				return FALSE;
+		if (name[0] == '.' && (namelen == 1 || (namelen == 2 && name[1] == '.')))
+			return FALSE;
 
-			if (!IsRoot(fullpathbuf))
-				FbxStrlcat(fs, fullpathbuf, "/", FBX_MAX_PATH);
+		if ((len + 1 + namelen) >= FBX_MAX_PATH)
+			return FALSE;
 
-			FbxStrlcat(fs, fullpathbuf, tname, FBX_MAX_PATH);
-			name = p;
-			if (*name != '\0') name++;
-		}
+		if (len != 1)
+			fullpathbuf[len++] = '/';
+
+		memcpy(fullpathbuf + len, name, namelen);
+		len += namelen;
+		fullpathbuf[len] = '\0';
+
+		name = p;
+		if (*name != '\0') name++;
 	}
 
 	RDEBUGF("FbxLockName2Path: DONE => '%s'\n", fullpathbuf);
 	return TRUE;
 }
 
+/* Returns the full path of a name read from the directory of the lock. The
+ * path of the directory is only copied to lock->dirpath once per scan, or
+ * when it has been renamed, and after that just the name is replaced. The
+ * result stays valid until the next call.
+ */
+const char *FbxDirEntryPath(struct FbxFS *fs, struct FbxLock *lock, const char *name) {
+	struct Library *SysBase = fs->sysbase;
+	const char *dirpath = lock->entry->path;
+	size_t len;
+
+	if (lock->dirpath == NULL) {
+		lock->dirpath = AllocVecPooled(lock->mempool, FBX_MAX_PATH);
+		if (lock->dirpath == NULL) {
+			fs->r2 = ERROR_NO_FREE_STORE;
+			return NULL;
+		}
+		lock->dirpathlen = 0;
+	}
+
+	if (lock->dirpathlen == 0 || lock->dirpathgen != fs->pathgen) {
+		len = strlen(dirpath);
+		memcpy(lock->dirpath, dirpath, len);
+		if (!IsRoot(dirpath))
+			lock->dirpath[len++] = '/';
+		lock->dirpathlen = len;
+		lock->dirpathgen = fs->pathgen;
+	}
+
+	len = strlen(name);
+	if ((lock->dirpathlen + len) >= FBX_MAX_PATH) {
+		fs->r2 = ERROR_LINE_TOO_LONG;
+		return NULL;
+	}
+
+	memcpy(lock->dirpath + lock->dirpathlen, name, len + 1);
+	return lock->dirpath;
+}
+
 int FbxFuseErrno2Error(int error) {
 	switch (-error) {
 	case ENOSYS:    /* Function not implemented */  return ERROR_ACTION_NOT_KNOWN;
@@ -374,15 +666,64 @@ int FbxFuseErrno2Error(int error) {
 	}
 }
 
-void FbxSetEntryPath(struct FbxFS *fs, struct FbxEntry *e, const char *p) {
-	FbxStrlcpy(fs, e->path, p, FBX_MAX_PATH);
+BOOL FbxSetEntryPath(struct FbxFS *fs, struct FbxEntry *e, const char *p) {
+	struct Library *SysBase = fs->sysbase;
+	size_t size = min(strlen(p) + 1, FBX_MAX_PATH);
+	char *path;
+
+	// reuse the current buffer if the length doesn't change
+	if (e->path != NULL && strlen(e->path) + 1 == size) {
+		FbxStrlcpy(fs, e->path, p, size);
+	} else {
+		path = AllocVecPooled(fs->mempool, size);
+		if (path == NULL)
+			return FALSE;
+
+		FbxStrlcpy(fs, path, p, size);
+
+		if (e->path != NULL)
+			FreeVecPooled(fs->mempool, e->path);
+		e->path = path;
+	}
+
+	e->hash = FbxHashPath(fs, e->path);
+	return TRUE;
 }
 
-struct FbxEntry *FbxSetupEntry(struct FbxFS *fs, const char *path, int type, QUAD id) {
+/* Removes an entry from the hash table so that it can not be found under
+ * its path anymore, while keeping it usable for its locks
+ */
+void FbxDetachEntry(struct FbxFS *fs, struct FbxEntry *e) {
+	FbxRemoveEntry(fs, e);
+	e->hashchain.mln_Succ = &e->hashchain;
+	e->hashchain.mln_Pred = &e->hashchain;
+}
+
+/* Changes the path of an entry that is already in the hash table. If
+ * there isn't enough memory for the new path the entry is detached from the
+ * table instead so that it can not be found under its old path anymore.
+ */
+BOOL FbxRenameEntry(struct FbxFS *fs, struct FbxEntry *e, const char *p) {
+	DEBUGF("FbxRenameEntry(%p, %p, '%s')\n", fs, e, p);
+
+	fs->pathgen++;
+
+	if (!FbxSetEntryPath(fs, e, p)) {
+		FbxDetachEntry(fs, e);
+		return FALSE;
+	}
+
+	FbxRehashEntry(fs, e);
+	return TRUE;
+}
+
+static struct FbxEntry *FbxNewEntry(struct FbxFS *fs, const char *path, int type, QUAD id,
+	struct FbxEntry *parent)
+{
 	struct Library *SysBase = fs->sysbase;
 	struct FbxEntry *e;
 
-	DEBUGF("FbxSetupEntry(%p, '%s', %d, 0x%llx)\n", fs, path, type, (long long)id);
+	DEBUGF("FbxNewEntry(%p, '%s', %d, 0x%llx, %p)\n", fs, path, type, (long long)id, parent);
 
 	e = AllocFbxEntry(fs);
 	if (e == NULL) {
@@ -390,36 +731,147 @@ struct FbxEntry *FbxSetupEntry(struct FbxFS *fs, const char *path, int type, QUA
 		return NULL;
 	}
 
-	FbxSetEntryPath(fs, e, path);
+	e->path = NULL;
+	if (!FbxSetEntryPath(fs, e, path)) {
+		FreeFbxEntry(fs, e);
+		fs->r2 = ERROR_NO_FREE_STORE;
+		return NULL;
+	}
+
 	NEWMINLIST(&e->locklist);
 	NEWMINLIST(&e->notifylist);
+	NEWMINLIST(&e->children);
 	e->xlock = FALSE;
 	e->type = type;
+	e->statvalid = FALSE;
+	e->sizevalid = FALSE;
+	e->comment = NULL;
+	e->xattrvalid = FALSE;
 
 	if (fs->fsflags & FBXF_USE_INO)
 		e->diskkey = id;
 	else
-		e->diskkey = FbxHashPathIno(fs, path);
+		e->diskkey = e->hash;
+
+	e->parent = parent;
+	if (parent != NULL)
+		AddTail((struct List *)&parent->children, (struct Node *)&e->sibling);
 
 	FbxAddEntry(fs, e); // add to hash
 
+	return e;
+}
+
+/* Returns the entry for the path in pathbuf if it is in the hash table,
+ * otherwise the entry for its closest parent directory that is. On return
+ * pathbuf holds the path of the entry found (or "/" if none was found).
+ */
+struct FbxEntry *FbxFindClosestEntry(struct FbxFS *fs, char *pathbuf) {
+	struct FbxEntry *e;
+
+	do {
+		e = FbxFindEntry(fs, pathbuf);
+		if (e != NULL) return e;
+	} while (FbxParentPath(fs, pathbuf));
+
+	return NULL;
+}
+
+/* Returns the entry for the parent directory of path. Entries for any
+ * parent directories that aren't in the hash table are set up as well so
+ * that every entry is always linked to the root entry through its parents.
+ * The diskkey of such entries is not known if FBXF_USE_INO is set and is
+ * filled in later when they are locked.
+ */
+struct FbxEntry *FbxObtainParentEntry(struct FbxFS *fs, const char *path) {
+	struct FbxEntry *parent, *e;
+	char pathbuf[FBX_MAX_PATH];
+	const char *p;
+	size_t len;
+
+	DEBUGF("FbxObtainParentEntry(%p, '%s')\n", fs, path);
+
+	FbxStrlcpy(fs, pathbuf, path, FBX_MAX_PATH);
+	if (!FbxParentPath(fs, pathbuf))
+		return NULL;
+
+	parent = FbxFindClosestEntry(fs, pathbuf);
+	if (parent == NULL) {
+		parent = FbxNewEntry(fs, "/", ETYPE_DIR, 0, NULL);
+		if (parent == NULL) return NULL;
+	}
+
+	// pathbuf is a prefix of path, set up the missing directories after it
+	len = IsRoot(pathbuf) ? 0 : strlen(pathbuf);
+	while ((p = strchr(path + len + 1, '/')) != NULL) {
+		len = p - path;
+		memcpy(pathbuf, path, len);
+		pathbuf[len] = '\0';
+
+		e = FbxNewEntry(fs, pathbuf, ETYPE_DIR, 0, parent);
+		if (e == NULL) {
+			FbxCleanupEntry(fs, parent);
+			return NULL;
+		}
+		parent = e;
+	}
+
+	return parent;
+}
+
+struct FbxEntry *FbxSetupEntry(struct FbxFS *fs, const char *path, int type, QUAD id) {
+	struct FbxEntry *parent = NULL;
+	struct FbxEntry *e;
+
+	DEBUGF("FbxSetupEntry(%p, '%s', %d, 0x%llx)\n", fs, path, type, (long long)id);
+
+	if (!IsRoot(path)) {
+		parent = FbxObtainParentEntry(fs, path);
+		if (parent == NULL) {
+			fs->r2 = ERROR_NO_FREE_STORE;
+			return NULL;
+		}
+	}
+
+	e = FbxNewEntry(fs, path, type, id, parent);
+	if (e == NULL) {
+		FbxCleanupEntry(fs, parent);
+		return NULL;
+	}
+
 	fs->r2 = 0;
 	return e;
 }
 
+/* Frees the entry if it is no longer in use, and then any of its parent
+ * directory entries that were only kept around because of it.
+ */
 void FbxCleanupEntry(struct FbxFS *fs, struct FbxEntry *e) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxEntry *parent;
+
 	DEBUGF("FbxCleanupEntry(%p, %p)\n", fs, e);
-	if (e != NULL) {
-		struct Library *SysBase = fs->sysbase;
 
+	while (e != NULL) {
 		DEBUGF("FbxCleanupEntry: path '%s'\n", e->path);
 
-		if (IsMinListEmpty(&e->notifylist) && IsMinListEmpty(&e->locklist)) {
-			Remove((struct Node *)&e->hashchain);
-			FbxStrlcpy(fs, e->path, "<<im free!>>", FBX_MAX_PATH);
-			FreeFbxEntry(fs, e);
-			DEBUGF("FbxCleanupEntry: freed entry %p\n", e);
+		if (!IsMinListEmpty(&e->notifylist) || !IsMinListEmpty(&e->locklist) ||
+			!IsMinListEmpty(&e->children))
+		{
+			break;
 		}
+
+		parent = e->parent;
+		if (parent != NULL)
+			Remove((struct Node *)&e->sibling);
+
+		FbxRemoveEntry(fs, e);
+		FbxInvalidateEntryXattrs(fs, e);
+		FreeVecPooled(fs->mempool, e->path);
+		FreeFbxEntry(fs, e);
+		DEBUGF("FbxCleanupEntry: freed entry %p\n", e);
+
+		e = parent;
 	}
 }
 
@@ -431,16 +883,72 @@ BOOL FbxCheckLock(struct FbxFS *fs, struct FbxLock *lock) {
 	return TRUE;
 }
 
+static void FbxUpdateModifyTime(struct FbxFS *fs) {
+	ULONG maxgap = fs->aut ? fs->aut : ACTIVE_UPDATE_TIMEOUT_MILLIS;
+	ULONG gap;
+
+	fs->lastmodify = FbxGetUpTimeMillis(fs);
+	if (fs->lastmodify == 0) fs->lastmodify++; /* Don't set to zero */
+	if (fs->firstmodify == 0)
+		fs->firstmodify = fs->lastmodify;
+
+	/* Keep a running average of the time between modifications, so that
+	 * files which are written to a little at a time, like logs, don't get
+	 * flushed after every write. A long pause starts over.
+	 */
+	gap = fs->lastmodify - fs->prevmodify;
+	if (fs->prevmodify != 0 && gap < maxgap)
+		fs->modifygap = (fs->modifygap * 3 + gap) / 4;
+	else
+		fs->modifygap = 0;
+	fs->prevmodify = fs->lastmodify;
+}
+
 void FbxSetModifyState(struct FbxFS *fs, int state) {
 	if (state) {
-		fs->lastmodify = FbxGetUpTimeMillis(fs);
-		if (fs->lastmodify == 0) fs->lastmodify++; /* Don't set to zero */
-		if (fs->firstmodify == 0)
-			fs->firstmodify = fs->lastmodify;
+		fs->currvol->metadirty = TRUE;
+		FbxUpdateModifyTime(fs);
 	} else {
 		fs->firstmodify = 0;
 		fs->lastmodify = 0;
+		fs->dirtybytes = 0;
+	}
+}
+
+/* Like FbxSetModifyState(fs, 1), but for changes to the data of an open
+ * file only, which FbxFlushAll() can commit with fsync() on its handle.
+ * bytes is the amount of data written, if any.
+ */
+void FbxSetFileModified(struct FbxFS *fs, struct FbxLock *lock, ULONG bytes) {
+	lock->flags |= LOCKFLAG_MODIFIED | LOCKFLAG_DIRTY;
+	FbxUpdateModifyTime(fs);
+	FbxInvalidateDirListing(fs, lock->entry->path);
+
+	if (fs->dirtybytes + bytes >= fs->dirtybytes)
+		fs->dirtybytes += bytes;
+	else
+		fs->dirtybytes = 0xFFFFFFFFUL;
+	fs->ratebytes += bytes;
+}
+
+/* Like FbxSetModifyState(fs, 1), but for changes to a single object that
+ * FbxFlushAll() can commit with fsync() on its path, like the data of a
+ * file that has been closed. This is only done if the file system has
+ * set FBXF_SYNC_PATHS and not too many objects are waiting for it,
+ * otherwise the whole file system is committed instead.
+ */
+void FbxSetPathModified(struct FbxFS *fs, const char *path) {
+	struct FbxVolume *vol = fs->currvol;
+
+	if (!(fs->fsflags & FBXF_SYNC_PATHS)) {
+		vol->metadirty = TRUE;
+	} else if (FbxFindPathNode(fs, &vol->dirtypaths, path) == NULL &&
+		(vol->dirtypaths.count >= vol->dirtypaths.maxcount ||
+		FbxAddPathNode(fs, &vol->dirtypaths, path) == NULL))
+	{
+		vol->metadirty = TRUE;
 	}
+	FbxUpdateModifyTime(fs);
 }
 
 BOOL FbxIsParent(struct FbxFS *fs, const char *parent, const char *child) {
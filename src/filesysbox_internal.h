@@ -278,8 +278,10 @@ size_t FbxDebugPrintf(const char *fmt, ...);
 #define min(x,y) ((x)<(y)?(x):(y))
 #define max(x,y) ((x)>(y)?(x):(y))
 
-#define ENTRYHASHSIZE 256
-#define ENTRYHASHMASK 255
+#define ENTRYHASHSIZE    64 // initial (and minimum) number of hash buckets
+#define ENTRYHASHMAXLOAD 2  // grow table when entries > buckets * ENTRYHASHMAXLOAD
+#define ENTRYHASHMINLOAD 8  // shrink table when entries < buckets / ENTRYHASHMINLOAD
+#define ENTRYHASHSTEPS   4  // non-empty buckets migrated per table access while resizing
 
 #define FSOP fs->ops.
 
@@ -299,21 +301,122 @@ size_t FbxDebugPrintf(const char *fmt, ...);
 #endif
 
 struct FbxEntry {
-	struct MinNode hashchain;
-	char           path[FBX_MAX_PATH]; // full path to file (and root = "/")
-	struct MinList locklist; // list of locks
-	struct MinList notifylist; // list of notifys
-	BOOL           xlock; // true if exclusively locked
-	LONG           type; // ETYPE_XXX
-	UQUAD          diskkey; // st_ino copy
+	struct MinNode   hashchain;
+	char            *path; // full path to file (and root = "/"), allocated from fs->mempool
+	ULONG            hash; // FbxHashPath() of path
+	struct FbxEntry *parent; // parent directory entry (NULL for root)
+	struct MinNode   sibling; // in parent->children
+	struct MinList   children; // entries for objects in this directory
+	struct MinList   locklist; // list of locks
+	struct MinList   notifylist; // list of notifys
+	BOOL             xlock; // true if exclusively locked
+	LONG             type; // ETYPE_XXX
+	UQUAD            diskkey; // st_ino copy
+	struct fbx_stat  statbuf; // cached attributes
+	ULONG            stattime; // FbxGetUpTimeMillis() when statbuf was filled in
+	BOOL             statvalid; // true if statbuf is valid
+	QUAD             filesize; // size of the file while it is open
+	BOOL             sizevalid; // true if filesize is valid
+	ULONG            amigaprot; // cached amiga protection flags
+	char            *comment; // cached comment (NULL if empty), allocated from fs->mempool
+	ULONG            xattrtime; // FbxGetUpTimeMillis() when amigaprot and comment were filled in
+	BOOL             xattrvalid; // true if amigaprot and comment are valid
 };
 
 #define FSENTRYFROMHASHCHAIN(chain) container_of(chain, struct FbxEntry, hashchain)
+#define FSENTRYFROMSIBLING(chain) container_of(chain, struct FbxEntry, sibling)
+
+/* entries of volumes that are no longer current are unlinked from the hash
+ * table with their hashchain pointing to itself, so that Remove() is harmless.
+ */
+#define ENTRYDETACHED(e) ((e)->hashchain.mln_Succ == &(e)->hashchain)
 
 #define ETYPE_NONE 0
 #define ETYPE_FILE 1
 #define ETYPE_DIR  2
 
+#define PATHCACHEHASHSIZE 64
+#define NEGCACHEMAXENTRIES 256 // maximum number of negative lookup cache entries
+#define ARCHPENDINGMAXENTRIES 256 // maximum number of pending archive flag clears
+#define ARCHCLEAREDMAXENTRIES 256 // maximum number of remembered cleared archive flags
+#define DIRTYPATHSMAXENTRIES 256 // maximum number of objects to fsync() by path
+
+struct FbxPathNode {
+	struct MinNode hashchain;
+	struct MinNode lruchain;
+	ULONG          hash; // FbxHashPath() of path
+	ULONG          dirhash; // FbxHashPath() of parent directory path
+	ULONG          time; // FbxGetUpTimeMillis() when added or refreshed
+	char           path[1];
+};
+
+#define FSPATHNODEFROMHASHCHAIN(chain) container_of(chain, struct FbxPathNode, hashchain)
+#define FSPATHNODEFROMLRUCHAIN(chain) container_of(chain, struct FbxPathNode, lruchain)
+
+struct FbxPathCache {
+	struct MinList hashtab[PATHCACHEHASHSIZE];
+	struct MinList lrulist; // least recently used first
+	ULONG          count;
+	ULONG          maxcount;
+};
+
+#define BLOCKCACHEHASHSIZE 256
+#define BLOCKCACHEBLOCKSIZE 4096 // size of the blocks in the block cache
+
+struct FbxCachedFile {
+	struct MinNode   hashchain;
+	struct MinList   blocks;
+	UQUAD            id; // diskkey of the file
+	struct FbxBlock *eofblock; // cached block that ends before BLOCKCACHEBLOCKSIZE, if any
+};
+
+struct FbxBlock {
+	struct MinNode        hashchain;
+	struct MinNode        lruchain;
+	struct MinNode        filechain;
+	struct FbxCachedFile *file;
+	UQUAD                 index; // offset in file / BLOCKCACHEBLOCKSIZE
+	LONG                  len; // number of valid bytes in data
+	UBYTE                 data[BLOCKCACHEBLOCKSIZE];
+};
+
+#define FSCACHEDFILEFROMHASHCHAIN(chain) container_of(chain, struct FbxCachedFile, hashchain)
+#define FSBLOCKFROMHASHCHAIN(chain) container_of(chain, struct FbxBlock, hashchain)
+#define FSBLOCKFROMLRUCHAIN(chain) container_of(chain, struct FbxBlock, lruchain)
+#define FSBLOCKFROMFILECHAIN(chain) container_of(chain, struct FbxBlock, filechain)
+
+struct FbxBlockCache {
+	struct MinList hashtab[BLOCKCACHEHASHSIZE]; // blocks
+	struct MinList filetab[BLOCKCACHEHASHSIZE]; // files with cached blocks
+	struct MinList lrulist; // least recently used first
+	ULONG          count;
+	ULONG          maxcount;
+};
+
+#define DIRCACHEHASHSIZE 64
+
+/* A cached directory listing. The header is followed by size bytes of
+ * records, which all have DIRDATAF_ATTRS set, and the path of the directory.
+ */
+struct FbxDirListing {
+	struct MinNode hashchain;
+	struct MinNode lruchain;
+	ULONG          hash; // FbxHashPath() of path
+	ULONG          size; // number of bytes used by records
+	char          *path;
+};
+
+#define FSDIRLISTINGFROMHASHCHAIN(chain) container_of(chain, struct FbxDirListing, hashchain)
+#define FSDIRLISTINGFROMLRUCHAIN(chain) container_of(chain, struct FbxDirListing, lruchain)
+
+struct FbxDirCache {
+	struct MinList hashtab[DIRCACHEHASHSIZE];
+	struct MinList lrulist; // least recently used first
+	ULONG          size; // number of bytes used by listings
+	ULONG          maxsize;
+	ULONG          generation; // incremented by every change that may affect a listing
+};
+
 /* fs->currvol uses sentinel values:
  *   NULL      = no current volume (for example no disk, or inhibited access)
  *   (APTR)-1  = backend layout is invalid or not formatted
@@ -334,7 +437,20 @@ struct FbxVolume {
 	struct MinList    unres_notifys;
 	struct MinList    locklist;
 	struct MinList    notifylist;
-	struct MinList    entrytab[ENTRYHASHSIZE]; // hashtable
+	struct MinList   *entrytab; // hashtable
+	ULONG             entrymask; // number of buckets - 1
+	struct MinList   *oldentrytab; // hashtable being migrated from while resizing
+	ULONG             oldentrymask;
+	ULONG             rehashidx; // next bucket in oldentrytab to migrate
+	ULONG             numentries;
+	struct FbxPathCache negcache; // negative lookup cache
+	struct FbxPathCache archpending; // objects whose archive flag is to be cleared
+	struct FbxPathCache archcleared; // objects known to have the archive flag cleared
+	struct FbxPathCache dirtypaths; // closed files and directories to fsync() by path
+	struct FbxBlockCache blockcache; // file data shared by all handles
+	struct FbxDirCache dircache; // listings of unchanged directories
+	struct MinList    ralist; // locks with pending readahead
+	BOOL              metadirty; // changes that need fsync("/")
 	ULONG             blocksize;
 	UBYTE             volnamelen;
 	char              volname[CONN_VOLUME_NAME_BYTES];
@@ -399,8 +515,32 @@ struct fbx_operations {
 	STDARGS int (*bmap) (const char *, size_t blocksize, UQUAD *idx, struct fuse_context *);
 	STDARGS int (*format) (const char *, ULONG, struct fuse_context *);
 	STDARGS int (*relabel) (const char *, struct fuse_context *);
+	STDARGS int (*getamigaattr) (const char *, struct fbx_stat *, ULONG *, char *, size_t, struct fuse_context *);
+	STDARGS int (*read_buf) (const char *, struct fbx_bufvec *, size_t, fbx_off_t, struct fuse_file_info *, struct fuse_context *);
+	STDARGS int (*write_buf) (const char *, const struct fbx_bufvec *, fbx_off_t, struct fuse_file_info *, struct fuse_context *);
+	STDARGS int (*fallocate) (const char *, int, fbx_off_t, fbx_off_t, struct fuse_file_info *, struct fuse_context *);
+	STDARGS int (*copy_file_range) (const char *, struct fuse_file_info *, fbx_off_t,
+		const char *, struct fuse_file_info *, fbx_off_t, size_t, int, struct fuse_context *);
+	STDARGS int (*readdir_filter) (const char *, void *, fuse_fill_dir_t, fbx_off_t,
+		const struct fbx_dir_filter *, struct fuse_file_info *, struct fuse_context *);
+};
+
+#define MERGEMAXPACKETS 16 // maximum number of read or write packets handled in one go
+#define MERGEMAXBYTES 262144 // maximum combined size of such packets
+
+#define COPYBUFSIZE 262144 // buffer size for copying a file range with read and write
+
+#define BUFVECMAXSEGS 16 // number of segments in a struct FbxBufVec
+
+// struct fbx_bufvec with room for BUFVECMAXSEGS segments
+struct FbxBufVec {
+	struct fbx_bufvec bv;
+	struct fbx_buf    more[BUFVECMAXSEGS - 1];
 };
 
+// the buffers of merged write packets are passed on in a struct FbxBufVec
+STATIC_ASSERT(MERGEMAXPACKETS <= BUFVECMAXSEGS, "too many merged packets for struct FbxBufVec");
+
 // set by setupvolume, based on struct statvfs flags
 #define FBXVF_CASE_SENSITIVE 1
 #define FBXVF_READ_ONLY      2
@@ -456,8 +596,26 @@ struct FbxFS {
 	LONG                         inhibit;
 	ULONG                        aut; // active auto update timeout
 	ULONG                        iaut; // inactive auto update timeout
+	ULONG                        negtimeout; // negative lookup cache timeout
+	ULONG                        attrtimeout; // attribute cache timeout
+	ULONG                        rbufsize; // per handle read buffer size
+	ULONG                        wbufsize; // per handle write buffer size
+	ULONG                        bcachesize; // size of the block cache of each volume
+	ULONG                        dcachesize; // size of the directory cache of each volume
+	ULONG                        pathgen; // incremented whenever an entry is renamed
+	ULONG                        rasize; // maximum readahead window size
+	ULONG                        dirtylimit; // flush when this much data has been written
 	ULONG                        firstmodify;
 	ULONG                        lastmodify;
+	ULONG                        prevmodify; // like lastmodify, but not reset by flushing
+	ULONG                        modifygap; // average time between modifications
+	ULONG                        dirtybytes; // bytes written since the last flush
+	ULONG                        ratebytes; // bytes written since ratetime
+	ULONG                        ratetime;
+	ULONG                        writerate; // average bytes written per second
+	ULONG                        thresholdflushes;
+	ULONG                        ageflushes;
+	ULONG                        idleflushes;
 	LONG                         timerbusy;
 	LONG                         diskchangesig;
 	struct FbxDiskChangeHandler *diskchangehandler;
@@ -478,6 +636,8 @@ struct FbxFS {
 #define FBX_TIMER_MICROS 100000
 #define ACTIVE_UPDATE_TIMEOUT_MILLIS 10000
 #define INACTIVE_UPDATE_TIMEOUT_MILLIS 500
+#define WRITE_RATE_INTERVAL_MILLIS 1000
+#define ATTR_TIMEOUT_MILLIS 1000 // used for FBX_TIMEOUT_INFINITE on writable volumes
 
 #define CHECKVOLUME(errbool) \
 	if (NOVOLUME(fs->currvol)) { \
@@ -509,6 +669,56 @@ struct FbxFS {
 		return errbool; \
 	}
 
+/* Directory entries read by readdir() are packed one after the other into
+ * chunks of at least DIRCHUNKSIZE bytes, see dirbuffer.c.
+ */
+struct FbxDirChunk {
+	struct MinNode node;
+	ULONG          size; // number of bytes for records after the header
+	ULONG          used; // number of bytes used by records
+};
+
+#define DIRCHUNKSIZE 8192
+
+struct FbxDirBuffer {
+	struct MinList      chunks;
+	struct FbxDirChunk *readchunk; // chunk holding the next record to read, NULL if none read yet
+	ULONG               readpos; // offset of the next record in readchunk
+	ULONG               count; // number of records added
+};
+
+/* The parts of struct fbx_stat that are used for directory entries */
+struct FbxDirStat {
+	UQUAD           ino;
+	QUAD            size;
+	QUAD            blocks;
+	struct timespec mtim;
+	mode_t          mode;
+	uid_t           uid;
+	gid_t           gid;
+	ULONG           prot; // amiga protection flags, if DIRDATAF_ATTRS is set
+};
+
+/* A record is followed by a FbxDirStat if DIRDATAF_STAT is set, the
+ * NUL-terminated name and, if DIRDATAF_ATTRS is set, the NUL-terminated
+ * comment.
+ */
+struct FbxDirData {
+	ULONG reclen; // size of the record including padding
+	UWORD nameoffset; // offset of the name from the start of the record
+	UWORD flags; // DIRDATAF_XXX
+};
+
+#define DIRDATAF_STAT  1 // stat data is valid
+#define DIRDATAF_ATTRS 2 // protection flags and comment are valid too
+
+#define DIRDATAALIGN 8
+#define DIRDATANAME(dd) ((char *)(dd) + (dd)->nameoffset)
+#define DIRDATASTAT(dd) ((struct FbxDirStat *)((dd) + 1))
+#define DIRDATACOMMENT(dd) (DIRDATANAME(dd) + strlen(DIRDATANAME(dd)) + 1)
+#define DIRDATAHASSTAT(dd) (((dd)->flags & DIRDATAF_STAT) != 0)
+#define DIRDATAHASATTRS(dd) (((dd)->flags & DIRDATAF_ATTRS) != 0)
+
 struct FbxLock {
 	BPTR                   link; // not used (fl_Link)
 	IPTR                   diskid; // ino (fl_Key)
@@ -524,10 +734,38 @@ struct FbxLock {
 	struct FbxFS          *fs;
 	struct FileHandle     *fh;
 	APTR                   mempool;
-	struct MinList         dirdatalist;
+	struct FbxDirBuffer    dirbuf; // entries read from the directory
+	struct FbxDirBuffer    dirlist; // complete records collected for the directory cache
+	BOOL                   dirlisting; // true while records are collected into dirlist
+	ULONG                  dirgen; // dircache generation when the directory was read
 	LONG                   dirscan;
+	struct fuse_file_info *dirinfo; // if directory is being read in chunks and opened
+	QUAD                   diroffset; // offset to continue reading the directory from
+	LONG                   dirchunk; // number of entries read by the current readdir()
+	BOOL                   dirmore; // readdir() stopped because the chunk was full
+	const struct fbx_dir_filter *dirfilter; // passed to readdir_filter(), NULL for readdir()
+	char                  *dirpath; // directory path and the current name, see FbxDirEntryPath()
+	ULONG                  dirpathlen; // length of the directory part of dirpath, 0 if not set up
+	ULONG                  dirpathgen; // fs->pathgen when dirpath was set up
 	QUAD                   filepos;
 	ULONG                  flags; // LOCKFLAG_XXX
+	UBYTE                 *rbuf; // read buffer (fs->rbufsize bytes), allocated from fs->mempool
+	QUAD                   rbufpos; // file position of read buffer contents
+	LONG                   rbuflen; // number of valid bytes in read buffer
+	UBYTE                 *wbuf; // write buffer (fs->wbufsize bytes), allocated from fs->mempool
+	QUAD                   wbufpos; // file position of write buffer contents
+	LONG                   wbuflen; // number of bytes in write buffer
+	LONG                   wbuferr; // error from a deferred write, reported on next operation
+	QUAD                   ranext; // file position where the next sequential read starts
+	LONG                   rawindow; // readahead window size, 0 if not reading sequentially
+	BOOL                   raeof; // end of file reached by readahead
+	UBYTE                 *rabuf; // readahead buffer (fs->rasize bytes), allocated from fs->mempool
+	QUAD                   rabufpos; // file position of readahead buffer contents
+	LONG                   rabuflen; // number of valid bytes in readahead buffer
+	struct MinNode         rachain; // in fsvol->ralist while readahead is pending
+	LONG                   appendcount; // number of consecutive writes at end of file
+	LONG                   preallocsize; // size of the last preallocation
+	QUAD                   preallocend; // end of space preallocated beyond end of file
 };
 
 STATIC_ASSERT(offsetof(struct FbxLock, link) == offsetof(struct FileLock, fl_Link),
@@ -541,10 +779,24 @@ STATIC_ASSERT(offsetof(struct FbxLock, taskmp) == offsetof(struct FileLock, fl_T
 STATIC_ASSERT(offsetof(struct FbxLock, volumebptr) == offsetof(struct FileLock, fl_Volume),
               "offset of fl_Volume differs between FbxLock and FileLock.");
 
-#define LOCKFLAG_MODIFIED 1
+#define LOCKFLAG_MODIFIED   1
+#define LOCKFLAG_NOPREALLOC 2 // fallocate() failed, don't try again
+#define LOCKFLAG_DIRTY      4 // written to since the last fsync()
+
+#define PREALLOCMINAPPENDS 4 // consecutive writes at end of file before preallocating
+#define PREALLOCMINSIZE 65536 // size of the first preallocation
+#define PREALLOCMAXSIZE 4194304 // maximum size of a preallocation
+
+#define RAMINWINDOW 16384 // initial readahead window size
+
+#define DIRCHUNKENTRIES 128 // entries read at a time from file systems that support offsets
+
+// rachain is only linked while readahead is pending for the lock
+#define RAPENDING(lock) ((lock)->rachain.mln_Succ != NULL)
 
 #define FSLOCKFROMENTRYCHAIN(chain) container_of(chain, struct FbxLock, entrychain)
 #define FSLOCKFROMVOLUMECHAIN(chain) container_of(chain, struct FbxLock, volumechain)
+#define FSLOCKFROMRACHAIN(chain) container_of(chain, struct FbxLock, rachain)
 
 struct FbxNotifyNode {
 	struct MinNode        chain; // either entry->notifylist or fs->unres_notifys for unresolved ones..
@@ -558,24 +810,11 @@ struct FbxNotifyNode {
 #define FSNOTIFYNODEFROMCHAIN(chain_) container_of(chain_, struct FbxNotifyNode, chain)
 #define FSNOTIFYNODEFROMVOLUMECHAIN(chain_) container_of(chain_, struct FbxNotifyNode, volumechain)
 
-struct FbxDirData {
-	struct MinNode  node;
-	char           *fsname;
-
-	/* Only used by ExAll() */
-#ifdef ENABLE_CHARSET_CONVERSION
-	char           *name;
-#endif
-	char           *comment;
-
-	struct fbx_stat stat;
-};
-
-#define FSDIRDATAFROMNODE(chain) container_of(chain, struct FbxDirData, node)
-
 struct FbxExAllState { // exallctrl->lastkey points to this
-	struct MinList freelist; // FbxDirData's to free from previous invocation of exall
-	LONG           eadsize; // cached value
+	struct FbxDirBuffer   strings; // names and comments returned by the previous invocation of exall
+	LONG                  eadsize; // cached value
+	struct fbx_dir_filter filter; // derived from eac_MatchString
+	char                  filterbuf[FBX_MAX_NAME * 3]; // glob, prefix and suffix of filter
 };
 
 #define AllocStructure(name) (struct name *)AllocMem(sizeof(struct name), MEMF_PUBLIC|MEMF_CLEAR)
@@ -606,7 +845,6 @@ struct FbxExAllState { // exallctrl->lastkey points to this
 #define AllocFbxExAllState(lock) AllocStructurePooled((lock)->mempool, FbxExAllState)
 #define FreeFbxExAllState(lock,eas) FreeStructurePooled((lock)->mempool, eas, FbxExAllState)
 
-#define AllocFbxDirData(lock,len) (struct FbxDirData *)AllocVecPooled((lock)->mempool, sizeof(struct FbxDirData) + (len))
 
 #define AllocFuseFileInfo(fs) AllocStructurePooled((fs)->mempool, fuse_file_info)
 #define FreeFuseFileInfo(fs,ffi) FreeStructurePooled((fs)->mempool, ffi, fuse_file_info)
@@ -647,19 +885,31 @@ int FbxStrcmp(struct FbxFS *fs, const char *s1, const char *s2);
 int FbxStrncmp(struct FbxFS *fs, const char *s1, const char *s2, size_t n);
 size_t FbxStrlcpy(struct FbxFS *fs, char *dst, const char *src, size_t dst_size);
 size_t FbxStrlcat(struct FbxFS *fs, char *dst, const char *src, size_t dst_size);
+ULONG FbxHashPath(struct FbxFS *fs, const char *str);
 IPTR FbxHashPathIno(struct FbxFS *fs, const char *str);
 struct FbxEntry *FbxFindEntry(struct FbxFS *fs, const char *path);
 struct FbxLock *FbxLockEntry(struct FbxFS *fs, struct FbxEntry *e, int mode);
 void FbxEndLock(struct FbxFS *fs, struct FbxLock *lock);
+BOOL FbxSetupEntryTable(struct FbxFS *fs, struct FbxVolume *vol);
+void FbxCleanupEntryTable(struct FbxFS *fs, struct FbxVolume *vol);
 void FbxAddEntry(struct FbxFS *fs, struct FbxEntry *e);
+void FbxRemoveEntry(struct FbxFS *fs, struct FbxEntry *e);
+void FbxRehashEntry(struct FbxFS *fs, struct FbxEntry *e);
 BOOL FbxLockName2Path(struct FbxFS *fs, struct FbxLock *lock, const char *name, char *fullpathbuf);
+const char *FbxDirEntryPath(struct FbxFS *fs, struct FbxLock *lock, const char *name);
 int FbxFuseErrno2Error(int error);
-void FbxSetEntryPath(struct FbxFS *fs, struct FbxEntry *e, const char *p);
+BOOL FbxSetEntryPath(struct FbxFS *fs, struct FbxEntry *e, const char *p);
+void FbxDetachEntry(struct FbxFS *fs, struct FbxEntry *e);
+BOOL FbxRenameEntry(struct FbxFS *fs, struct FbxEntry *e, const char *p);
+struct FbxEntry *FbxFindClosestEntry(struct FbxFS *fs, char *pathbuf);
+struct FbxEntry *FbxObtainParentEntry(struct FbxFS *fs, const char *path);
 struct FbxEntry *FbxSetupEntry(struct FbxFS *fs, const char *path, int type, QUAD id);
 void FbxCleanupEntry(struct FbxFS *fs, struct FbxEntry *e);
 BOOL FbxCheckLock(struct FbxFS *fs, struct FbxLock *lock);
 void FbxNotifyDiskChange(struct FbxFS *fs, UBYTE ieclass);
 void FbxSetModifyState(struct FbxFS *fs, int state);
+void FbxSetFileModified(struct FbxFS *fs, struct FbxLock *lock, ULONG bytes);
+void FbxSetPathModified(struct FbxFS *fs, const char *path);
 BOOL FbxIsParent(struct FbxFS *fs, const char *parent, const char *child);
 void FbxTimeSpec2DS(struct FbxFS *fs, const struct timespec *ts, struct DateStamp *ds);
 
@@ -722,6 +972,9 @@ int FbxChangeMode(struct FbxFS *fs, struct FbxLock *lock, int mode);
 /* fsclose.c */
 int FbxCloseFile(struct FbxFS *fs, struct FbxLock *lock);
 
+/* fscopyfilerange.c */
+int FbxCopyFileRange(struct FbxFS *fs, struct FbxLock *srclock, struct FbxLock *dstlock, int bytes);
+
 /* fscreatedir.c */
 struct FbxLock *FbxCreateDir(struct FbxFS *fs, struct FbxLock *lock, const char *name);
 
@@ -750,8 +1003,6 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR len
 	int type, struct ExAllControl *ctrl);
 
 /* fsexamineallend.c */
-void FreeFbxDirData(struct FbxLock *lock, struct FbxDirData *dd);
-void FreeFbxDirDataList(struct FbxLock *lock, struct MinList *list);
 int FbxExamineAllEnd(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR len,
 	int type, struct ExAllControl *ctrl);
 
@@ -760,14 +1011,17 @@ LONG FbxMode2EntryType(const mode_t mode);
 ULONG FbxMode2Protection(const mode_t mode);
 UWORD FbxUnix2AmigaOwner(const uid_t owner);
 void FbxPathStat2FIB(struct FbxFS *fs, const char *fullpath, struct fbx_stat *stat,
-	struct FileInfoBlock *fib);
+	ULONG amigaprot, const char *comment, struct FileInfoBlock *fib);
 int FbxExamineLock(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock *fib);
 
 /* fsexaminenext.c */
-int FbxReadDir(struct FbxFS *fs, struct FbxLock *lock);
+void FbxEndReadDir(struct FbxFS *fs, struct FbxLock *lock);
+int FbxReadDir(struct FbxFS *fs, struct FbxLock *lock, const struct fbx_dir_filter *filter);
+int FbxReadDirMore(struct FbxFS *fs, struct FbxLock *lock);
 int FbxExamineNext(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock *fib);
 
 /* fsflush.c */
+void FbxFlushArchiveFlags(struct FbxFS *fs);
 int FbxFlushAll(struct FbxFS *fs);
 
 /* fsformat.c */
@@ -809,6 +1063,10 @@ struct FbxLock *FbxLocateParent(struct FbxFS *fs, struct FbxLock *lock);
 
 /* fsread.c */
 int FbxReadFile(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, int bytes);
+void FbxInvalidateReadBuffers(struct FbxFS *fs, struct FbxEntry *e);
+void FbxCancelReadahead(struct FbxFS *fs, struct FbxLock *lock);
+BOOL FbxReadaheadPending(struct FbxFS *fs);
+void FbxDoReadahead(struct FbxFS *fs);
 
 /* fsreadlink.c */
 int FbxReadLink(struct FbxFS *fs, struct FbxLock *lock, const char *name,
@@ -854,11 +1112,75 @@ int FbxSetProtection(struct FbxFS *fs, struct FbxLock *lock, const char *name, U
 int FbxUnLockObject(struct FbxFS *fs, struct FbxLock *lock);
 
 /* fswrite.c */
+void FbxFlushWriteBuffer(struct FbxFS *fs, struct FbxLock *lock);
+int FbxCommitWriteBuffer(struct FbxFS *fs, struct FbxLock *lock);
+void FbxFlushWriteBuffers(struct FbxFS *fs, struct FbxEntry *e);
+void FbxFlushDirWriteBuffers(struct FbxFS *fs, struct FbxEntry *dir);
+void FbxFlushAllWriteBuffers(struct FbxFS *fs);
+void FbxTrimPreallocation(struct FbxFS *fs, struct FbxLock *lock);
+int FbxWriteFileVec(struct FbxFS *fs, struct FbxLock *lock, const struct fbx_bufvec *bufv, int bytes);
 int FbxWriteFile(struct FbxFS *fs, struct FbxLock *lock, CONST_APTR buffer, int bytes);
 
 /* fswriteprotect.c */
 int FbxWriteProtect(struct FbxFS *fs, int on_off, IPTR passkey);
 
+/* attrcache.c */
+int FbxGetEntryAttr(struct FbxFS *fs, struct FbxEntry *e, struct fbx_stat *stat,
+	struct fuse_file_info *fi);
+int FbxGetPathAttr(struct FbxFS *fs, const char *path, struct fbx_stat *stat);
+void FbxSetEntryAttr(struct FbxFS *fs, struct FbxEntry *e, const struct fbx_stat *stat);
+void FbxInvalidateEntryAttr(struct FbxFS *fs, struct FbxEntry *e);
+BOOL FbxEntryAttrsCached(struct FbxFS *fs, struct FbxEntry *e);
+void FbxInvalidatePathAttr(struct FbxFS *fs, const char *path);
+BOOL FbxGetEntryXattrs(struct FbxFS *fs, struct FbxEntry *e, ULONG *prot, char *comment, size_t size);
+void FbxSetEntryXattrs(struct FbxFS *fs, struct FbxEntry *e, ULONG prot, const char *comment);
+void FbxInvalidateEntryXattrs(struct FbxFS *fs, struct FbxEntry *e);
+void FbxInvalidatePathXattrs(struct FbxFS *fs, const char *path);
+
+/* blockcache.c */
+void FbxInitBlockCache(struct FbxBlockCache *bc, ULONG maxcount);
+BOOL FbxUseBlockCache(struct FbxFS *fs, struct FbxLock *lock);
+struct FbxBlock *FbxFindBlock(struct FbxFS *fs, UQUAD id, UQUAD index);
+struct FbxBlock *FbxAllocBlock(struct FbxFS *fs);
+void FbxFreeBlock(struct FbxFS *fs, struct FbxBlock *block);
+BOOL FbxInsertBlock(struct FbxFS *fs, struct FbxBlock *block, UQUAD id, UQUAD index, LONG len);
+void FbxInvalidateBlocks(struct FbxFS *fs, UQUAD id, QUAD offset);
+void FbxInvalidateBlockRange(struct FbxFS *fs, UQUAD id, QUAD offset, QUAD len);
+void FbxFlushBlockCache(struct FbxFS *fs, struct FbxBlockCache *bc);
+
+/* dircache.c */
+void FbxInitDirCache(struct FbxDirCache *dc, ULONG maxsize);
+BOOL FbxGetDirListing(struct FbxFS *fs, struct FbxLock *lock);
+void FbxStartDirListing(struct FbxFS *fs, struct FbxLock *lock);
+void FbxAddDirListingEntry(struct FbxFS *fs, struct FbxLock *lock, const char *name,
+	const struct fbx_stat *stat, ULONG prot, const char *comment);
+void FbxFinishDirListing(struct FbxFS *fs, struct FbxLock *lock);
+void FbxEndDirListing(struct FbxLock *lock);
+void FbxInvalidateDirListing(struct FbxFS *fs, const char *path);
+void FbxInvalidateDirListingTree(struct FbxFS *fs, const char *path);
+void FbxFlushDirCache(struct FbxFS *fs, struct FbxDirCache *dc);
+
+/* dirbuffer.c */
+void FbxInitDirBuffer(struct FbxDirBuffer *db);
+APTR FbxAllocDirBuffer(struct FbxLock *lock, struct FbxDirBuffer *db, ULONG size);
+struct FbxDirData *FbxAddDirData(struct FbxLock *lock, struct FbxDirBuffer *db, const char *name,
+	const struct fbx_stat *stat, ULONG prot, const char *comment);
+struct FbxDirData *FbxNextDirData(struct FbxDirBuffer *db);
+BOOL FbxDirBufferEmpty(struct FbxDirBuffer *db);
+void FbxReleaseDirData(struct FbxLock *lock, struct FbxDirBuffer *db);
+void FbxFreeDirBuffer(struct FbxLock *lock, struct FbxDirBuffer *db);
+void FbxDirStat2Stat(const struct FbxDirStat *ds, struct fbx_stat *stat);
+
+/* pathcache.c */
+void FbxInitPathCache(struct FbxPathCache *pc, ULONG maxcount);
+struct FbxPathNode *FbxFindPathNode(struct FbxFS *fs, struct FbxPathCache *pc, const char *path);
+void FbxRemovePathNode(struct FbxFS *fs, struct FbxPathCache *pc, struct FbxPathNode *pn);
+struct FbxPathNode *FbxAddPathNode(struct FbxFS *fs, struct FbxPathCache *pc, const char *path);
+void FbxInvalidatePathDir(struct FbxFS *fs, struct FbxPathCache *pc, const char *path);
+void FbxFlushPathCache(struct FbxFS *fs, struct FbxPathCache *pc);
+int FbxCachedGetAttr(struct FbxFS *fs, const char *path, struct fbx_stat *stat);
+void FbxInvalidateNegative(struct FbxFS *fs, const char *path);
+
 /* volume.c */
 struct FbxVolume *FbxSetupVolume(struct FbxFS *fs);
 void FbxCleanupVolume(struct FbxFS *fs);
@@ -867,6 +1189,9 @@ void FbxCleanupVolume(struct FbxFS *fs);
 ULONG FbxGetAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath);
 int FbxSetAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath, ULONG prot);
 void FbxGetComment(struct FbxFS *fs, const char *fullpath, char *comment, size_t size);
+void FbxGetAmigaAttrs(struct FbxFS *fs, const char *fullpath, ULONG *prot, char *comment, size_t size);
+int FbxGetAmigaStat(struct FbxFS *fs, const char *fullpath, struct fbx_stat *stat,
+	ULONG *prot, char *comment, size_t size);
 
 /* allocvecpooled.c */
 #ifndef __AROS__
@@ -48,9 +48,9 @@ int FbxAddNotify(struct FbxFS *fs, struct NotifyRequest *notify) {
 		return DOSFALSE;
 	}
 
-	error = Fbx_getattr(fs, fullpath, &statbuf);
+	error = FbxCachedGetAttr(fs, fullpath, &statbuf);
 	if (error) {
-		if (fs->r2 == -ENOENT) { // file did not exist
+		if (error == -ENOENT) { // file did not exist
 			NDEBUGF("FbxAddNotify: file '%s' did not exist.\n", fullpath);
 
 			nn = AllocFbxNotifyNode();
@@ -83,10 +83,14 @@ int FbxAddNotify(struct FbxFS *fs, struct NotifyRequest *notify) {
 		if (e == NULL) {
 			e = FbxSetupEntry(fs, fullpath, etype, statbuf.st_ino);
 			if (e == NULL) return DOSFALSE;
+		} else if (e->diskkey == 0 && (fs->fsflags & FBXF_USE_INO)) {
+			// entry was set up as the parent directory of another one
+			e->diskkey = statbuf.st_ino;
 		}
 
 		nn = AllocFbxNotifyNode();
 		if (nn == NULL) {
+			FbxCleanupEntry(fs, e);
 			fs->r2 = ERROR_NO_FREE_STORE;
 			return DOSFALSE;
 		}
@@ -12,23 +12,52 @@
 #include "fuse_stubs.h"
 #include <string.h>
 
+/* Queues the archive flags of the file and its parent directories to be
+ * cleared by FbxFlushArchiveFlags(). Once an object is known to have its
+ * archive flag cleared, so are its parent directories, so the walk can
+ * stop there.
+ */
 static void FbxClearArchiveFlags(struct FbxFS *fs, const char *fullpath) {
+	struct FbxVolume *vol = fs->currvol;
 	char pathbuf[FBX_MAX_PATH];
 	ULONG prot;
 
 	FbxStrlcpy(fs, pathbuf, fullpath, FBX_MAX_PATH);
 	do {
-		prot = FbxGetAmigaProtectionFlags(fs, pathbuf);
-		if (prot & FIBF_ARCHIVE) {
-			prot &= ~FIBF_ARCHIVE;
-			FbxSetAmigaProtectionFlags(fs, pathbuf, prot);
+		if (FbxFindPathNode(fs, &vol->archcleared, pathbuf) != NULL)
+			break;
+
+		if (vol->archpending.count >= vol->archpending.maxcount)
+			FbxFlushArchiveFlags(fs);
+
+		if (FbxAddPathNode(fs, &vol->archpending, pathbuf) == NULL) {
+			// out of memory, clear it right away
+			prot = FbxGetAmigaProtectionFlags(fs, pathbuf);
+			if (prot & FIBF_ARCHIVE) {
+				prot &= ~FIBF_ARCHIVE;
+				FbxSetAmigaProtectionFlags(fs, pathbuf, prot);
+			}
 		}
 	} while (FbxParentPath(fs, pathbuf) && !IsRoot(pathbuf));
 }
 
+static BOOL FbxEntryIsOpen(struct FbxFS *fs, struct FbxEntry *e) {
+	struct MinNode *chain, *succ;
+	struct FbxLock *lock;
+
+	for (chain = e->locklist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		lock = FSLOCKFROMENTRYCHAIN(chain);
+		if (lock->info != NULL)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 int FbxCloseFile(struct FbxFS *fs, struct FbxLock *lock) {
 	struct Library *SysBase = fs->sysbase;
 	struct FbxEntry *e;
+	int error = 0;
 
 	PDEBUGF("FbxCloseFile(%p, %p)\n", fs, lock);
 
@@ -49,6 +78,10 @@ int FbxCloseFile(struct FbxFS *fs, struct FbxLock *lock) {
 	}
 
 	if (lock->info != NULL) {
+		if (lock->fsvol == fs->currvol) {
+			error = FbxCommitWriteBuffer(fs, lock);
+			FbxTrimPreallocation(fs, lock);
+		}
 		Fbx_release(fs, e->path, lock->info);
 		FreeFuseFileInfo(fs, lock->info);
 		lock->info = NULL;
@@ -56,15 +89,26 @@ int FbxCloseFile(struct FbxFS *fs, struct FbxLock *lock) {
 
 	lock->fh = NULL;
 
+	// the file size is only tracked while the file is open
+	if (!FbxEntryIsOpen(fs, e))
+		e->sizevalid = FALSE;
+
 	if (lock->fsvol == fs->currvol && (lock->flags & LOCKFLAG_MODIFIED)) {
 		FbxClearArchiveFlags(fs, e->path);
 		FbxDoNotify(fs, e->path);
-		FbxSetModifyState(fs, 1);
+		// commits the data as well as the archive flag cleared later
+		FbxSetPathModified(fs, e->path);
 	}
 
 	FbxEndLock(fs, lock);
 	FbxCleanupEntry(fs, e);
 
+	// report errors from deferred writes
+	if (error) {
+		fs->r2 = FbxFuseErrno2Error(error);
+		return DOSFALSE;
+	}
+
 	fs->r2 = 0;
 	return DOSTRUE;
 }
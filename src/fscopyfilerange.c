@@ -0,0 +1,147 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+#include <errno.h>
+
+static int Fbx_copy_file_range(struct FbxFS *fs, const char *srcpath, struct fuse_file_info *srcfi,
+	QUAD srcoffset, const char *dstpath, struct fuse_file_info *dstfi, QUAD dstoffset,
+	size_t len, int flags)
+{
+	ODEBUGF("Fbx_copy_file_range(%p, '%s', %p, %lld, '%s', %p, %lld, %zu, %d)\n", fs,
+		srcpath, srcfi, (long long)srcoffset, dstpath, dstfi, (long long)dstoffset, len, flags);
+
+	return FSOP copy_file_range(srcpath, srcfi, srcoffset, dstpath, dstfi, dstoffset, len, flags, &fs->fcntx);
+}
+
+/* Copies the range with read and write through a large buffer, without
+ * the data ever leaving the handler.
+ */
+static int FbxCopyFileRangeBuffered(struct FbxFS *fs, struct FbxLock *srclock,
+	struct FbxLock *dstlock, int bytes)
+{
+	struct Library *SysBase = fs->sysbase;
+	UBYTE *buffer;
+	int len, res, wres, total = 0;
+
+	len = min(bytes, COPYBUFSIZE);
+	buffer = AllocVecPooled(fs->mempool, len);
+	if (buffer == NULL) {
+		fs->r2 = ERROR_NO_FREE_STORE;
+		return -1;
+	}
+
+	while (total < bytes) {
+		len = min(bytes - total, COPYBUFSIZE);
+
+		res = FbxReadFile(fs, srclock, buffer, len);
+		if (res <= 0) {
+			if (res < 0 && total == 0) total = -1;
+			break;
+		}
+
+		wres = FbxWriteFile(fs, dstlock, buffer, res);
+		if (wres != res) {
+			// the source must not be ahead of what has been written
+			srclock->filepos -= res - max(wres, 0);
+			if (wres > 0) total += wres;
+			if (total == 0) total = -1;
+			break;
+		}
+
+		total += res;
+		if (res < len) break; // end of file
+	}
+
+	FreeVecPooled(fs->mempool, buffer);
+
+	if (total >= 0) fs->r2 = 0;
+	return total;
+}
+
+int FbxCopyFileRange(struct FbxFS *fs, struct FbxLock *srclock, struct FbxLock *dstlock, int bytes) {
+	struct FbxEntry *e;
+	int res;
+
+	PDEBUGF("FbxCopyFileRange(%p, %p, %p, %d)\n", fs, srclock, dstlock, bytes);
+
+	if (srclock != NULL && dstlock != NULL) {
+		CHECKLOCK(srclock, -1);
+		CHECKLOCK(dstlock, -1);
+
+		if (srclock->fsvol != fs->currvol || dstlock->fsvol != fs->currvol) {
+			fs->r2 = ERROR_NO_DISK;
+			return -1;
+		}
+	} else {
+		fs->r2 = ERROR_REQUIRED_ARG_MISSING;
+		return -1;
+	}
+
+	if (srclock->info == NULL || dstlock->info == NULL) {
+		fs->r2 = ERROR_OBJECT_WRONG_TYPE;
+		return -1;
+	}
+
+	CHECKWRITABLE(-1);
+
+	if (bytes < 0) {
+		fs->r2 = ERROR_BAD_NUMBER;
+		return -1;
+	}
+
+	if (bytes == 0) {
+		fs->r2 = 0;
+		return 0;
+	}
+
+	if (FSOP copy_file_range == NULL)
+		return FbxCopyFileRangeBuffered(fs, srclock, dstlock, bytes);
+
+	e = dstlock->entry;
+
+	// the file system must see all data written so far
+	FbxFlushWriteBuffers(fs, srclock->entry);
+	FbxFlushWriteBuffers(fs, e);
+	// report errors from deferred writes, the source data may be missing
+	if (srclock->wbuferr != 0) {
+		fs->r2 = FbxFuseErrno2Error(FbxCommitWriteBuffer(fs, srclock));
+		return -1;
+	}
+	if (dstlock->wbuferr != 0) {
+		fs->r2 = FbxFuseErrno2Error(FbxCommitWriteBuffer(fs, dstlock));
+		return -1;
+	}
+
+	res = Fbx_copy_file_range(fs, srclock->entry->path, srclock->info, srclock->filepos,
+		e->path, dstlock->info, dstlock->filepos, bytes, 0);
+	if (res == -ENOSYS || res == -EOPNOTSUPP || res == -EXDEV)
+		return FbxCopyFileRangeBuffered(fs, srclock, dstlock, bytes);
+
+	FbxInvalidateEntryAttr(fs, e);
+	FbxInvalidateReadBuffers(fs, e);
+	FbxInvalidateBlockRange(fs, e->diskkey, dstlock->filepos, bytes);
+	if (res < 0) {
+		e->sizevalid = FALSE;
+		fs->r2 = FbxFuseErrno2Error(res);
+		return -1;
+	}
+
+	srclock->filepos += res;
+	if (res > 0) {
+		dstlock->filepos += res;
+		if (e->sizevalid && dstlock->filepos > e->filesize)
+			e->filesize = dstlock->filepos;
+		FbxSetFileModified(fs, dstlock, res);
+	}
+
+	fs->r2 = 0;
+	return res;
+}
@@ -72,6 +72,9 @@ struct FbxLock *FbxCreateDir(struct FbxFS *fs, struct FbxLock *lock, const char
 
 	DEBUGF("FbxCreateDir created dir ok\n");
 
+	FbxInvalidateNegative(fs, fullpath);
+	FbxInvalidateDirListingTree(fs, fullpath);
+
 	error = Fbx_getattr(fs, fullpath, &statbuf);
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
@@ -85,6 +88,8 @@ struct FbxLock *FbxCreateDir(struct FbxFS *fs, struct FbxLock *lock, const char
 
 	FbxDoNotify(fs, fullpath);
 
+	FbxSetEntryAttr(fs, e, &statbuf);
+
 	lock2 = FbxLockEntry(fs, e, SHARED_LOCK);
 	if (lock2 == NULL) {
 		FbxCleanupEntry(fs, e);
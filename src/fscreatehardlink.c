@@ -82,6 +82,10 @@ int FbxMakeHardLink(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		return DOSFALSE;
 	}
 
+	FbxInvalidateNegative(fs, fullpath);
+	FbxInvalidateDirListingTree(fs, fullpath);
+	FbxInvalidatePathAttr(fs, fullpath2); // link count changed
+
 	FbxDoNotify(fs, fullpath);
 
 	FbxSetModifyState(fs, 1);
@@ -69,6 +69,9 @@ int FbxMakeSoftLink(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		return DOSFALSE;
 	}
 
+	FbxInvalidateNegative(fs, fullpath);
+	FbxInvalidateDirListingTree(fs, fullpath);
+
 	FbxDoNotify(fs, fullpath);
 
 	FbxSetModifyState(fs, 1);
@@ -78,7 +78,10 @@ int FbxDeleteObject(struct FbxFS *fs, struct FbxLock *lock, const char *name) {
 		return DOSFALSE;
 	}
 
-	error = Fbx_getattr(fs, fullpath, &statbuf);
+	if (e != NULL)
+		error = FbxGetEntryAttr(fs, e, &statbuf, NULL);
+	else
+		error = Fbx_getattr(fs, fullpath, &statbuf);
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
 		return DOSFALSE;
@@ -94,15 +97,21 @@ int FbxDeleteObject(struct FbxFS *fs, struct FbxLock *lock, const char *name) {
 		return DOSFALSE;
 	}
 
+	// the inode number may be reused for a new file
+	if (S_ISREG(statbuf.st_mode) && (fs->fsflags & FBXF_USE_INO))
+		FbxInvalidateBlocks(fs, statbuf.st_ino, 0);
+
 	if (e != NULL) {
+		FbxInvalidateEntryAttr(fs, e);
+		FbxInvalidateEntryXattrs(fs, e);
 		FbxUnResolveNotifys(fs, e);
 		FbxCleanupEntry(fs, e);
 	}
 
-	while (FbxParentPath(fs, fullpath)) {
-		e = FbxFindEntry(fs, fullpath);
-		if (e != NULL) FbxDoNotifyEntry(fs, e);
-	}
+	FbxInvalidateDirListingTree(fs, fullpath);
+
+	if (FbxParentPath(fs, fullpath))
+		FbxDoNotify(fs, fullpath);
 
 	FbxSetModifyState(fs, 1);
 
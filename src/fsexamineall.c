@@ -10,24 +10,76 @@
 
 #include "filesysbox_internal.h"
 #include "fuse_stubs.h"
+#include <dos/dosasl.h>
 #include <string.h>
 #include <stdint.h>
 
-static char *FbxExAllStrdup(struct FbxFS *fs, struct FbxLock *lock, const char *src, size_t srclen) {
-	struct Library *SysBase = fs->sysbase;
+static char *FbxExAllStrdup(struct FbxLock *lock, struct FbxExAllState *exallstate,
+	const char *src, size_t srclen)
+{
 	char *dst;
 
-	if (src == NULL)
-		return NULL;
-
-	dst = AllocVecPooled(lock->mempool, srclen + 1);
+	dst = FbxAllocDirBuffer(lock, &exallstate->strings, srclen + 1);
 	if (dst == NULL)
 		return NULL;
 
-	CopyMem(src, dst, srclen + 1);
+	memcpy(dst, src, srclen + 1);
 	return dst;
 }
 
+/* Derives a name filter for readdir_filter() from a pattern parsed by
+ * ParsePatternNoCase(). Only patterns made of ASCII characters and the
+ * tokens for '#?' and '?' are handled, anything else is left to
+ * MatchPatternNoCase() alone.
+ */
+static BOOL FbxPattern2DirFilter(const char *pattern, struct FbxExAllState *exallstate) {
+	struct fbx_dir_filter *filter = &exallstate->filter;
+	char *glob = exallstate->filterbuf;
+	char *prefix, *suffix;
+	size_t len, i, prefixlen = 0, suffixlen = 0;
+	BOOL wild = FALSE, single = FALSE;
+	UBYTE c;
+
+	len = strlen(pattern);
+	if (len >= FBX_MAX_NAME)
+		return FALSE;
+
+	for (i = 0; i < len; i++) {
+		c = pattern[i];
+		if (c == P_ANY || c == P_SINGLE) {
+			if (!wild) prefixlen = i;
+			wild = TRUE;
+			if (c == P_SINGLE) single = TRUE;
+			glob[i] = (c == P_ANY) ? '*' : '?';
+			suffixlen = 0;
+		} else if (c >= 0x80 || c < 0x20 || strchr("#?*()|~[]%'\\", c) != NULL) {
+			return FALSE;
+		} else {
+			glob[i] = c;
+			suffixlen++;
+		}
+	}
+	glob[len] = '\0';
+
+	if (!wild)
+		prefixlen = len;
+	else if (prefixlen == 0 && suffixlen == 0 && !single)
+		return FALSE; // matches everything
+
+	prefix = glob + len + 1;
+	memcpy(prefix, glob, prefixlen);
+	prefix[prefixlen] = '\0';
+
+	suffix = prefix + prefixlen + 1;
+	memcpy(suffix, glob + len - suffixlen, suffixlen + 1);
+
+	filter->flags  = FBX_DIRFILTER_NOCASE;
+	filter->glob   = glob;
+	filter->prefix = prefix;
+	filter->suffix = suffix;
+	return TRUE;
+}
+
 #define offset_after(type,member) (offsetof(type, member) + sizeof(((type *)0)->member))
 
 int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR bufsize,
@@ -38,11 +90,15 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 	struct Library *UtilityBase = fs->utilitybase;
 	struct FbxDirData *ed = NULL;
 	struct FbxExAllState *exallstate;
+	const struct fbx_dir_filter *filter;
 	int error, eadsize;
 	struct ExAllData *prevead, *curread;
 	struct DateStamp ds;
 	struct fbx_stat statbuf;
-	char fullpath[FBX_MAX_PATH];
+	const char *fullpath = NULL;
+	char fscomment[FBX_MAX_COMMENT];
+	ULONG amigaprot;
+	BOOL gotamigaattrs;
 #ifdef ENABLE_CHARSET_CONVERSION
 	char name[FBX_MAX_NAME];
 	size_t namelen;
@@ -65,30 +121,7 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 	ctrl->eac_Entries = 0;
 
 	if (ctrl->eac_LastKey == (IPTR)NULL) {
-		if (lock->mempool == NULL) {
-			lock->mempool = CreatePool(MEMF_PUBLIC, 4096, 1024);
-			if (lock->mempool == NULL) {
-				fs->r2 = ERROR_NO_FREE_STORE;
-				return DOSFALSE;
-			}
-		}
-
-		exallstate = AllocFbxExAllState(lock);
-		if (exallstate == NULL) {
-			fs->r2 = ERROR_NO_FREE_STORE;
-			return DOSFALSE;
-		}
-
-		FreeFbxDirDataList(lock, &lock->dirdatalist);
-		NEWMINLIST(&exallstate->freelist);
-
-		// read in entries
-		if (!FbxReadDir(fs, lock)) {
-			FreeFbxDirDataList(lock, &lock->dirdatalist);
-			FreeFbxExAllState(lock, exallstate);
-			return DOSFALSE;
-		}
-
+		// check the type before the directory is opened
 		switch (type) {
 		case ED_NAME:
 			eadsize = offset_after(struct ExAllData, ed_Name);
@@ -112,12 +145,42 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 			eadsize = offset_after(struct ExAllData, ed_OwnerGID);
 			break;
 		default:
-			FreeFbxDirDataList(lock, &lock->dirdatalist);
-			FreeFbxExAllState(lock, exallstate);
 			fs->r2 = ERROR_BAD_NUMBER; // unsupported ED_XXX
 			return DOSFALSE;
 		}
 
+		if (lock->mempool == NULL) {
+			lock->mempool = CreatePool(MEMF_PUBLIC, 4096, 1024);
+			if (lock->mempool == NULL) {
+				fs->r2 = ERROR_NO_FREE_STORE;
+				return DOSFALSE;
+			}
+		}
+
+		exallstate = AllocFbxExAllState(lock);
+		if (exallstate == NULL) {
+			fs->r2 = ERROR_NO_FREE_STORE;
+			return DOSFALSE;
+		}
+
+		FbxFreeDirBuffer(lock, &lock->dirbuf);
+		FbxInitDirBuffer(&exallstate->strings);
+
+		// let the file system leave out names that can't match
+		filter = NULL;
+		if (ctrl->eac_MatchString != NULL && ctrl->eac_MatchFunc == NULL &&
+			FbxPattern2DirFilter((const char *)ctrl->eac_MatchString, exallstate))
+		{
+			filter = &exallstate->filter;
+		}
+
+		// read in entries
+		if (!FbxReadDir(fs, lock, filter)) {
+			FbxFreeDirBuffer(lock, &lock->dirbuf);
+			FreeFbxExAllState(lock, exallstate);
+			return DOSFALSE;
+		}
+
 		exallstate->eadsize = eadsize;
 		ctrl->eac_LastKey = (IPTR)exallstate;
 	} else if (ctrl->eac_LastKey == (IPTR)-1) {
@@ -126,7 +189,8 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 	} else {
 		exallstate = (struct FbxExAllState *)ctrl->eac_LastKey;
 		// free previous exdata
-		FreeFbxDirDataList(lock, &exallstate->freelist);
+		FbxFreeDirBuffer(lock, &exallstate->strings);
+		FbxReleaseDirData(lock, &lock->dirbuf);
 	}
 
 	curread = (struct ExAllData *)buffer;
@@ -134,17 +198,19 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 	curread->ed_Next = NULL;
 	eadsize = exallstate->eadsize;
 	while (((IPTR)curread + eadsize) <= ((IPTR)buffer + bufsize)) {
-		ed = (struct FbxDirData *)RemHead((struct List *)&lock->dirdatalist);
+		if (!FbxReadDirMore(fs, lock))
+			return DOSFALSE;
+
+		ed = FbxNextDirData(&lock->dirbuf);
 		if (ed == NULL) break;
 
 #ifdef ENABLE_CHARSET_CONVERSION
-		if ((namelen = FbxUTF8ToLocal(fs, name, ed->fsname, FBX_MAX_NAME)) >= FBX_MAX_NAME)	{
-			FreeFbxDirData(lock, ed);
+		if ((namelen = FbxUTF8ToLocal(fs, name, DIRDATANAME(ed), FBX_MAX_NAME)) >= FBX_MAX_NAME)	{
 			fs->r2 = ERROR_LINE_TOO_LONG;
 			return DOSFALSE;
 		}
 #else
-		name = ed->fsname;
+		name = DIRDATANAME(ed);
 #endif
 
 		curread->ed_Next = NULL;
@@ -153,23 +219,34 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 			ctrl->eac_MatchFunc == NULL &&
 			!MatchPatternNoCase(ctrl->eac_MatchString, (STRPTR)name))
 		{
-			FreeFbxDirData(lock, ed);
 			continue;
 		}
 
+		gotamigaattrs = FALSE;
 		if (type >= ED_TYPE) {
-			if (!FbxLockName2Path(fs, lock, ed->fsname, fullpath)) {
-				FreeFbxDirData(lock, ed);
-				fs->r2 = ERROR_INVALID_COMPONENT_NAME;
+			fullpath = FbxDirEntryPath(fs, lock, DIRDATANAME(ed));
+			if (fullpath == NULL)
 				return DOSFALSE;
-			}
 
-			if (fs->fsflags & FBXF_USE_FILL_DIR_STAT) {
-				statbuf = ed->stat;
+			if (DIRDATAHASATTRS(ed)) {
+				FbxDirStat2Stat(DIRDATASTAT(ed), &statbuf);
+				amigaprot = DIRDATASTAT(ed)->prot;
+				if (type >= ED_COMMENT)
+					FbxStrlcpy(fs, fscomment, DIRDATACOMMENT(ed), FBX_MAX_COMMENT);
+				gotamigaattrs = TRUE;
+			} else if (DIRDATAHASSTAT(ed)) {
+				FbxDirStat2Stat(DIRDATASTAT(ed), &statbuf);
+			} else if (type >= ED_PROTECTION) {
+				error = FbxGetAmigaStat(fs, fullpath, &statbuf, &amigaprot,
+					(type >= ED_COMMENT) ? fscomment : NULL, FBX_MAX_COMMENT);
+				if (error) {
+					fs->r2 = FbxFuseErrno2Error(error);
+					return DOSFALSE;
+				}
+				gotamigaattrs = TRUE;
 			} else {
 				error = Fbx_getattr(fs, fullpath, &statbuf);
 				if (error) {
-					FreeFbxDirData(lock, ed);
 					fs->r2 = FbxFuseErrno2Error(error);
 					return DOSFALSE;
 				}
@@ -178,13 +255,11 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 
 		if (type >= ED_NAME) {
 #ifdef ENABLE_CHARSET_CONVERSION
-			ed->name = FbxExAllStrdup(fs, lock, name, namelen);
-			if (ed->name == NULL) {
-				FreeFbxDirData(lock, ed);
+			curread->ed_Name = (STRPTR)FbxExAllStrdup(lock, exallstate, name, namelen);
+			if (curread->ed_Name == NULL) {
 				fs->r2 = ERROR_NO_FREE_STORE;
 				return DOSFALSE;
 			}
-			curread->ed_Name = (STRPTR)ed->name;
 #else
 			curread->ed_Name = (STRPTR)name;
 #endif
@@ -199,8 +274,16 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 				curread->ed_Size = statbuf.st_size;
 		}
 		if (type >= ED_PROTECTION) {
+			// protection flags and comment are fetched together
+			if (!gotamigaattrs) {
+				FbxGetAmigaAttrs(fs, fullpath, &amigaprot,
+					(type >= ED_COMMENT) ? fscomment : NULL, FBX_MAX_COMMENT);
+			}
+			// only complete records can be used for the directory cache
+			if (type >= ED_COMMENT && !DIRDATAHASATTRS(ed))
+				FbxAddDirListingEntry(fs, lock, DIRDATANAME(ed), &statbuf, amigaprot, fscomment);
 			curread->ed_Prot  = FbxMode2Protection(statbuf.st_mode);
-			curread->ed_Prot |= FbxGetAmigaProtectionFlags(fs, fullpath);
+			curread->ed_Prot |= amigaprot;
 		}
 		if (type >= ED_DATE) {
 			FbxTimeSpec2DS(fs, &statbuf.st_mtim, &ds);
@@ -210,33 +293,28 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 		}
 		if (type >= ED_COMMENT) {
 #ifdef ENABLE_CHARSET_CONVERSION
-			char fscomment[FBX_MAX_COMMENT];
-#endif
 			char comment[FBX_MAX_COMMENT];
+#else
+			const char *comment = fscomment;
+#endif
 			size_t commentlen;
 #ifdef ENABLE_CHARSET_CONVERSION
-			FbxGetComment(fs, fullpath, fscomment, FBX_MAX_COMMENT);
 			if ((commentlen = FbxUTF8ToLocal(fs, comment, fscomment, FBX_MAX_COMMENT)) >= FBX_MAX_COMMENT) {
-				FreeFbxDirData(lock, ed);
 				fs->r2 = ERROR_LINE_TOO_LONG;
 				return DOSFALSE;
 			}
 #else
-			FbxGetComment(fs, fullpath, comment, FBX_MAX_COMMENT);
 			commentlen = strlen(comment);
 #endif
 			if (commentlen > 0) {
-				ed->comment = FbxExAllStrdup(fs, lock, comment, commentlen);
-				if (ed->comment == NULL) {
-					FreeFbxDirData(lock, ed);
+				curread->ed_Comment = (STRPTR)FbxExAllStrdup(lock, exallstate, comment, commentlen);
+				if (curread->ed_Comment == NULL) {
 					fs->r2 = ERROR_NO_FREE_STORE;
 					return DOSFALSE;
 				}
-			}
-			if (ed->comment != NULL)
-				curread->ed_Comment = (STRPTR)ed->comment;
-			else
+			} else {
 				curread->ed_Comment = (STRPTR)"";
+			}
 		}
 		if (type >= ED_OWNER) {
 			curread->ed_OwnerUID = FbxUnix2AmigaOwner(statbuf.st_uid);
@@ -246,12 +324,9 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 		if (ctrl->eac_MatchFunc != NULL &&
 			!CallHookPkt(ctrl->eac_MatchFunc, &type, curread))
 		{
-			FreeFbxDirData(lock, ed);
 			continue;
 		}
 
-		AddTail((struct List *)&exallstate->freelist, (struct Node *)ed);
-
 		ctrl->eac_Entries++;
 
 		if (prevead != NULL) prevead->ed_Next = curread; // link us in
@@ -259,7 +334,8 @@ int FbxExamineAll(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR buf
 		curread = (struct ExAllData *)((IPTR)curread + eadsize); // advance to next ead
 	}
 
-	if (IsMinListEmpty(&lock->dirdatalist)) {
+	if (FbxDirBufferEmpty(&lock->dirbuf) && !lock->dirmore) {
+		FbxFinishDirListing(fs, lock);
 		if (ctrl->eac_Entries == 0) {
 			FreeFbxExAllState(lock, exallstate);
 			ctrl->eac_LastKey = (IPTR)-1;
@@ -10,35 +10,6 @@
 
 #include "filesysbox_internal.h"
 
-void FreeFbxDirData(struct FbxLock *lock, struct FbxDirData *dd) {
-#ifdef __AROS__
-	extern struct Library *SysBase;
-#endif
-	if (dd != NULL) {
-		APTR pool = lock->mempool;
-
-#ifdef ENABLE_CHARSET_CONVERSION
-		if (dd->name != NULL)
-			FreeVecPooled(pool, dd->name);
-#endif
-
-		if (dd->comment != NULL)
-			FreeVecPooled(pool, dd->comment);
-
-		FreeVecPooled(pool, dd);
-	}
-}
-
-void FreeFbxDirDataList(struct FbxLock *lock, struct MinList *list) {
-	struct MinNode *chain, *succ;
-
-	for (chain = list->mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
-		FreeFbxDirData(lock, FSDIRDATAFROMNODE(chain));
-	}
-
-	NEWMINLIST(list);
-}
-
 int FbxExamineAllEnd(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR len,
 	int type, struct ExAllControl *ctrl)
 {
@@ -51,14 +22,18 @@ int FbxExamineAllEnd(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, SIPTR
 		exallstate = (struct FbxExAllState *)ctrl->eac_LastKey;
 		if (exallstate) {
 			if (exallstate != (APTR)-1) {
-				FreeFbxDirDataList(lock, &exallstate->freelist);
+				FbxFreeDirBuffer(lock, &exallstate->strings);
 				FreeFbxExAllState(lock, exallstate);
 			}
 			ctrl->eac_LastKey = (IPTR)NULL;
 		}
 	}
 
-	if (lock != NULL) FreeFbxDirDataList(lock, &lock->dirdatalist);
+	if (lock != NULL) {
+		FbxFreeDirBuffer(lock, &lock->dirbuf);
+		FbxEndDirListing(lock);
+		FbxEndReadDir(fs, lock);
+	}
 
 	fs->r2 = 0;
 	return DOSTRUE;
@@ -53,11 +53,10 @@ static const char *FbxFilePart(const char *path) {
 }
 
 void FbxPathStat2FIB(struct FbxFS *fs, const char *fullpath, struct fbx_stat *stat,
-	struct FileInfoBlock *fib)
+	ULONG amigaprot, const char *comment, struct FileInfoBlock *fib)
 {
 	struct FbxVolume *vol = fs->currvol;
 	size_t blen;
-	char comment[FBX_MAX_COMMENT];
 	LONG type;
 	QUAD filesize;
 
@@ -96,7 +95,6 @@ void FbxPathStat2FIB(struct FbxFS *fs, const char *fullpath, struct fbx_stat *st
 	fib->fib_FileName[0] = blen;
 	fib->fib_DirEntryType = fib->fib_EntryType = type;
 
-	FbxGetComment(fs, fullpath, comment, FBX_MAX_COMMENT);
 #ifdef ENABLE_CHARSET_CONVERSION
 	blen = FbxUTF8ToLocal(fs, (char *)&fib->fib_Comment[1], comment, sizeof(fib->fib_Comment));
 #else
@@ -120,7 +118,7 @@ void FbxPathStat2FIB(struct FbxFS *fs, const char *fullpath, struct fbx_stat *st
 		fib->fib_Size = filesize;
 
 	fib->fib_Protection = FbxMode2Protection(stat->st_mode);
-	fib->fib_Protection |= FbxGetAmigaProtectionFlags(fs, fullpath);
+	fib->fib_Protection |= amigaprot;
 
 	fib->fib_NumBlocks = stat->st_blocks;
 	if (fib->fib_NumBlocks == 0) {
@@ -144,6 +142,8 @@ void FbxPathStat2FIB(struct FbxFS *fs, const char *fullpath, struct fbx_stat *st
 
 int FbxExamineLock(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock *fib) {
 	struct fbx_stat statbuf;
+	ULONG amigaprot;
+	char comment[FBX_MAX_COMMENT];
 	int error;
 
 	PDEBUGF("FbxExamineLock(%p, %p, %p)\n", fs, lock, fib);
@@ -160,18 +160,22 @@ int FbxExamineLock(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock
 		return DOSFALSE;
 	}
 
-	FreeFbxDirDataList(lock, &lock->dirdatalist);
+	FbxFreeDirBuffer(lock, &lock->dirbuf);
+	FbxEndDirListing(lock);
+	FbxEndReadDir(fs, lock);
 
-	if (!lock->info) {
-		error = Fbx_getattr(fs, lock->entry->path, &statbuf);
+	if (lock->info != NULL) {
+		error = FbxGetEntryAttr(fs, lock->entry, &statbuf, lock->info);
+		if (error == 0)
+			FbxGetAmigaAttrs(fs, lock->entry->path, &amigaprot, comment, FBX_MAX_COMMENT);
 	} else {
-		error = Fbx_fgetattr(fs, lock->entry->path, &statbuf, lock->info);
+		error = FbxGetAmigaStat(fs, lock->entry->path, &statbuf, &amigaprot, comment, FBX_MAX_COMMENT);
 	}
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
 		return DOSFALSE;
 	}
-	FbxPathStat2FIB(fs, lock->entry->path, &statbuf, fib);
+	FbxPathStat2FIB(fs, lock->entry->path, &statbuf, amigaprot, comment, fib);
 	lock->dirscan = FALSE;
 	fs->r2 = 0;
 	return DOSTRUE;
@@ -11,6 +11,7 @@
 #include "filesysbox_internal.h"
 #include "fuse_stubs.h"
 #include <string.h>
+#include <errno.h>
 
 static int Fbx_opendir(struct FbxFS *fs, const char *path, struct fuse_file_info *fi)
 {
@@ -34,49 +35,122 @@ static int Fbx_readdir(struct FbxFS *fs, const char *path, APTR udata, fuse_fill
 	return FSOP readdir(path, udata, func, offset, fi, &fs->fcntx);
 }
 
+static int Fbx_readdir_filter(struct FbxFS *fs, const char *path, APTR udata, fuse_fill_dir_t func,
+	QUAD offset, const struct fbx_dir_filter *filter, struct fuse_file_info *fi)
+{
+	ODEBUGF("Fbx_readdir_filter(%p, '%s', %p, %p, %lld, '%s', %p)\n", fs, path, udata, func,
+		(long long)offset, filter->glob, fi);
+
+	return FSOP readdir_filter(path, udata, func, offset, filter, fi, &fs->fcntx);
+}
+
+/* File systems that pass the offset of the next entry to the fill function
+ * are read DIRCHUNKENTRIES entries at a time, with the fill function
+ * returning 1 once the chunk is full. The next readdir() call then continues
+ * from the offset passed with the last entry that was added. File systems
+ * that pass zero offsets are read in one go.
+ */
 static STDARGS int dir_fill_func(void *udata, const char *name, const struct fbx_stat *stat, fbx_off_t offset) {
 	struct FbxLock *lock = udata;
 	struct FbxFS *fs = lock->fs;
-	struct Library *SysBase = fs->sysbase;
-	struct FbxDirData *ed;
-	size_t namesize;
 
 	if (name == NULL) return 2;
 
+	if (offset != 0 && lock->dirchunk >= DIRCHUNKENTRIES) {
+		lock->dirmore = TRUE;
+		return 1;
+	}
+
 	if (!IsDotOrDotDot(name)) {
 		if (FbxCheckString(fs, name)) {
-			namesize = strlen(name) + 1;
-			ed = AllocFbxDirData(lock, namesize);
-			if (ed == NULL) return 1;
-
-			ed->fsname = (char *)(ed + 1);
-
-			/* Only used by ExAll() */
-#ifdef ENABLE_CHARSET_CONVERSION
-			ed->name    = NULL;
-#endif
-			ed->comment = NULL;
-
-			CopyMem(name, ed->fsname, namesize);
-			if (stat != NULL)
-			{
-				ed->stat = *stat;
-			}
-			else
-			{
-				ed->stat.st_ino = 0;
-			}
+			if (!(fs->fsflags & FBXF_USE_FILL_DIR_STAT))
+				stat = NULL;
 
-			AddTail((struct List *)&lock->dirdatalist, (struct Node *)ed);
+			if (FbxAddDirData(lock, &lock->dirbuf, name, stat, 0, NULL) == NULL) {
+				if (offset != 0) lock->dirmore = TRUE;
+				return 1;
+			}
 		}
 	}
 
+	lock->diroffset = offset;
+	lock->dirchunk++;
+
 	return 0;
 }
 
-int FbxReadDir(struct FbxFS *fs, struct FbxLock *lock) {
+/* Closes the directory handle of an unfinished directory read */
+void FbxEndReadDir(struct FbxFS *fs, struct FbxLock *lock) {
+	struct Library *SysBase = fs->sysbase;
+
+	if (lock->dirinfo != NULL) {
+		Fbx_releasedir(fs, lock->entry->path, lock->dirinfo);
+		FreeFuseFileInfo(fs, lock->dirinfo);
+		lock->dirinfo = NULL;
+	}
+
+	lock->dirmore   = FALSE;
+	lock->dirfilter = NULL;
+}
+
+static int FbxReadDirChunk(struct FbxFS *fs, struct FbxLock *lock) {
+	int error;
+
+	lock->dirchunk = 0;
+	lock->dirmore  = FALSE;
+
+	if (lock->dirfilter != NULL) {
+		error = Fbx_readdir_filter(fs, lock->entry->path, lock, dir_fill_func, lock->diroffset,
+			lock->dirfilter, lock->dirinfo);
+		if (error == -ENOSYS && lock->diroffset == 0 && lock->dirchunk == 0) {
+			// fall back to reading all names
+			lock->dirfilter = NULL;
+			lock->dirmore   = FALSE;
+			error = Fbx_readdir(fs, lock->entry->path, lock, dir_fill_func, 0, lock->dirinfo);
+		}
+	} else {
+		error = Fbx_readdir(fs, lock->entry->path, lock, dir_fill_func, lock->diroffset, lock->dirinfo);
+	}
+	if (error == 0 && lock->dirmore && lock->dirchunk == 0) {
+		// not even a single entry could be added
+		error = -ENOMEM;
+	}
+
+	if (error || !lock->dirmore)
+		FbxEndReadDir(fs, lock);
+
+	if (error) {
+		fs->r2 = FbxFuseErrno2Error(error);
+		return DOSFALSE;
+	}
+
+	return DOSTRUE;
+}
+
+/* Starts reading the directory of the lock into lock->dirbuf. If the
+ * file system supports offsets only the first chunk of entries is read, and
+ * FbxReadDirMore() must be called to get the next one when the list has
+ * been used up. Directories with a cached listing are not read at all.
+ *
+ * If filter is not NULL and the file system has readdir_filter() it may
+ * leave out names that don't match the filter, which must then stay valid
+ * until the directory has been read. Such partial listings are not cached.
+ */
+int FbxReadDir(struct FbxFS *fs, struct FbxLock *lock, const struct fbx_dir_filter *filter) {
 	int error;
 
+	FbxEndReadDir(fs, lock);
+	FbxEndDirListing(lock);
+
+	if (FbxGetDirListing(fs, lock))
+		return DOSTRUE;
+
+	// make sure that the sizes of files being written are up to date
+	FbxFlushDirWriteBuffers(fs, lock->entry);
+
+	if (filter == NULL || FSOP readdir_filter == NULL)
+		FbxStartDirListing(fs, lock);
+
 	if (FSOP opendir != FSOP open) {
 		struct Library *SysBase = fs->sysbase;
 		struct fuse_file_info *fi;
@@ -95,33 +169,35 @@ int FbxReadDir(struct FbxFS *fs, struct FbxLock *lock) {
 			return DOSFALSE;
 		}
 
-		error = Fbx_readdir(fs, lock->entry->path, lock, dir_fill_func, 0, fi);
-		if (error) {
-			Fbx_releasedir(fs, lock->entry->path, fi);
-			FreeFuseFileInfo(fs, fi);
-			fs->r2 = FbxFuseErrno2Error(error);
-			return DOSFALSE;
-		}
-
-		Fbx_releasedir(fs, lock->entry->path, fi);
-		FreeFuseFileInfo(fs, fi);
-	} else {
-		error = Fbx_readdir(fs, lock->entry->path, lock, dir_fill_func, 0, NULL);
-		if (error) {
-			fs->r2 = FbxFuseErrno2Error(error);
-			return DOSFALSE;
-		}
+		lock->dirinfo = fi;
 	}
 
-	return DOSTRUE;
+	// set only now, as FbxReadDirChunk() clears it again if it fails
+	if (FSOP readdir_filter != NULL)
+		lock->dirfilter = filter;
+
+	lock->diroffset = 0;
+	return FbxReadDirChunk(fs, lock);
+}
+
+/* Reads the next chunk of entries if all entries in lock->dirbuf have been
+ * read and the directory has not been read to the end yet.
+ */
+int FbxReadDirMore(struct FbxFS *fs, struct FbxLock *lock) {
+	if (!FbxDirBufferEmpty(&lock->dirbuf) || !lock->dirmore)
+		return DOSTRUE;
+
+	return FbxReadDirChunk(fs, lock);
 }
 
 int FbxExamineNext(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock *fib) {
 	struct Library *SysBase = fs->sysbase;
 	struct FbxDirData *ed;
 	struct fbx_stat statbuf;
+	ULONG amigaprot;
 	int error;
-	char fullpath[FBX_MAX_PATH];
+	const char *fullpath;
+	char comment[FBX_MAX_COMMENT];
 
 	PDEBUGF("FbxExamineNext(%p, %p, %p)\n", fs, lock, fib);
 
@@ -146,38 +222,50 @@ int FbxExamineNext(struct FbxFS *fs, struct FbxLock *lock, struct FileInfoBlock
 			}
 		}
 
-		if (!FbxReadDir(fs, lock)) {
-			FreeFbxDirDataList(lock, &lock->dirdatalist);
+		if (!FbxReadDir(fs, lock, NULL)) {
+			FbxFreeDirBuffer(lock, &lock->dirbuf);
 			return DOSFALSE;
 		}
 		lock->dirscan = TRUE;
 	}
 
-	ed = (struct FbxDirData *)RemHead((struct List *)&lock->dirdatalist);
+	// the entry returned by the previous call is no longer needed
+	FbxReleaseDirData(lock, &lock->dirbuf);
+
+	if (!FbxReadDirMore(fs, lock))
+		return DOSFALSE;
+
+	ed = FbxNextDirData(&lock->dirbuf);
 	if (ed == NULL) {
+		FbxFinishDirListing(fs, lock);
 		fs->r2 = ERROR_NO_MORE_ENTRIES;
 		return DOSFALSE;
 	}
 
-	if (!FbxLockName2Path(fs, lock, ed->fsname, fullpath)) {
-		FreeFbxDirData(lock, ed);
-		fs->r2 = ERROR_OBJECT_NOT_FOUND;
+	fullpath = FbxDirEntryPath(fs, lock, DIRDATANAME(ed));
+	if (fullpath == NULL)
 		return DOSFALSE;
-	}
 
-	if (fs->fsflags & FBXF_USE_FILL_DIR_STAT) {
-		statbuf = ed->stat;
-		FreeFbxDirData(lock, ed);
+	if (DIRDATAHASATTRS(ed)) {
+		FbxDirStat2Stat(DIRDATASTAT(ed), &statbuf);
+		amigaprot = DIRDATASTAT(ed)->prot;
+		FbxStrlcpy(fs, comment, DIRDATACOMMENT(ed), FBX_MAX_COMMENT);
 	} else {
-		FreeFbxDirData(lock, ed);
-		error = Fbx_getattr(fs, fullpath, &statbuf);
-		if (error) {
-			fs->r2 = FbxFuseErrno2Error(error);
-			return DOSFALSE;
+		if (DIRDATAHASSTAT(ed)) {
+			FbxDirStat2Stat(DIRDATASTAT(ed), &statbuf);
+			FbxGetAmigaAttrs(fs, fullpath, &amigaprot, comment, FBX_MAX_COMMENT);
+		} else {
+			error = FbxGetAmigaStat(fs, fullpath, &statbuf, &amigaprot, comment, FBX_MAX_COMMENT);
+			if (error) {
+				fs->r2 = FbxFuseErrno2Error(error);
+				return DOSFALSE;
+			}
 		}
+
+		FbxAddDirListingEntry(fs, lock, DIRDATANAME(ed), &statbuf, amigaprot, comment);
 	}
 
-	FbxPathStat2FIB(fs, fullpath, &statbuf, fib);
+	FbxPathStat2FIB(fs, fullpath, &statbuf, amigaprot, comment, fib);
 
 	fs->r2 = 0;
 	return DOSTRUE;
@@ -17,11 +17,80 @@ static int Fbx_fsync(struct FbxFS *fs, const char *path, int x, struct fuse_file
 	return FSOP fsync(path, x, fi, &fs->fcntx);
 }
 
+/* Clears the archive flags of the objects queued by FbxCloseFile() */
+void FbxFlushArchiveFlags(struct FbxFS *fs) {
+	struct FbxVolume *vol = fs->currvol;
+	struct MinNode *chain;
+	struct FbxPathNode *pn;
+	ULONG prot;
+
+	while ((chain = vol->archpending.lrulist.mlh_Head)->mln_Succ != NULL) {
+		pn = FSPATHNODEFROMLRUCHAIN(chain);
+
+		prot = FbxGetAmigaProtectionFlags(fs, pn->path);
+		if (prot & FIBF_ARCHIVE) {
+			prot &= ~FIBF_ARCHIVE;
+			FbxSetAmigaProtectionFlags(fs, pn->path, prot);
+		}
+		FbxAddPathNode(fs, &vol->archcleared, pn->path);
+
+		FbxRemovePathNode(fs, &vol->archpending, pn);
+	}
+}
+
+/* Commits the files that have been written to since the last flush with
+ * fsync() on their own handles, or if the file system has set
+ * FBXF_SYNC_PATHS on their paths once they have been closed, together with
+ * the directories that files have been created in. fsync("/") is only used
+ * when other changes have been made, or when the file system has asked for
+ * it with FBXF_SYNC_ROOT. Cleared archive flags
+ * aren't worth an fsync("/") of their own.
+ */
+static void FbxSyncVolume(struct FbxFS *fs) {
+	struct FbxVolume *vol = fs->currvol;
+	struct MinNode *chain, *succ;
+	struct FbxLock *lock;
+	struct FbxPathNode *pn;
+	BOOL syncroot = vol->metadirty;
+
+	if (fs->fsflags & FBXF_SYNC_ROOT)
+		syncroot = TRUE;
+
+	for (chain = vol->locklist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		lock = FSLOCKFROMVOLUMECHAIN(chain);
+		if (!(lock->flags & LOCKFLAG_DIRTY))
+			continue;
+
+		lock->flags &= ~LOCKFLAG_DIRTY;
+		if (syncroot)
+			continue;
+
+		if (lock->info != NULL)
+			Fbx_fsync(fs, lock->entry->path, 0, lock->info);
+		else
+			syncroot = TRUE;
+	}
+
+	while ((chain = vol->dirtypaths.lrulist.mlh_Head)->mln_Succ != NULL) {
+		pn = FSPATHNODEFROMLRUCHAIN(chain);
+		if (!syncroot)
+			Fbx_fsync(fs, pn->path, 0, NULL);
+		FbxRemovePathNode(fs, &vol->dirtypaths, pn);
+	}
+
+	if (syncroot)
+		Fbx_fsync(fs, "/", 0, NULL);
+
+	vol->metadirty = FALSE;
+}
+
 int FbxFlushAll(struct FbxFS *fs) {
 	PDEBUGF("FbxFlushAll(%p)\n", fs);
 
 	if (OKVOLUME(fs->currvol)) {
-		Fbx_fsync(fs, "/", 0, NULL);
+		FbxFlushAllWriteBuffers(fs);
+		FbxFlushArchiveFlags(fs);
+		FbxSyncVolume(fs);
 	}
 
 	/* reset update timeouts */
@@ -12,6 +12,7 @@
 #include "fuse_stubs.h"
 
 QUAD FbxGetFileSize(struct FbxFS *fs, struct FbxLock *lock) {
+	struct FbxEntry *e;
 	struct fbx_stat statbuf;
 	int error;
 
@@ -29,12 +30,28 @@ QUAD FbxGetFileSize(struct FbxFS *fs, struct FbxLock *lock) {
 		return -1;
 	}
 
-	error = Fbx_fgetattr(fs, lock->entry->path, &statbuf, lock->info);
+	e = lock->entry;
+
+	/* While a file is open its size is only changed through filesysbox,
+	 * so it only needs to be fetched once and is then kept up to date
+	 * by FbxWriteFile() and FbxSetFileSize64().
+	 */
+	if (lock->info != NULL && e->sizevalid) {
+		fs->r2 = 0;
+		return e->filesize;
+	}
+
+	error = FbxGetEntryAttr(fs, e, &statbuf, lock->info);
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
 		return -1;
 	}
 
+	if (lock->info != NULL) {
+		e->filesize  = statbuf.st_size;
+		e->sizevalid = TRUE;
+	}
+
 	fs->r2 = 0;
 	return statbuf.st_size;
 }
@@ -28,7 +28,7 @@ struct FbxLock *FbxInternalLocateObject(struct FbxFS *fs, struct FbxLock *lock,
 		return NULL;
 	}
 
-	error = Fbx_getattr(fs, fullpath, &statbuf);
+	error = FbxGetPathAttr(fs, fullpath, &statbuf);
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
 		return NULL;
@@ -47,6 +47,10 @@ struct FbxLock *FbxInternalLocateObject(struct FbxFS *fs, struct FbxLock *lock,
 	if (e == NULL) {
 		e = FbxSetupEntry(fs, fullpath, ntype, statbuf.st_ino);
 		if (e == NULL) return NULL;
+		FbxSetEntryAttr(fs, e, &statbuf);
+	} else if (e->diskkey == 0 && (fs->fsflags & FBXF_USE_INO)) {
+		// entry was set up as the parent directory of another one
+		e->diskkey = statbuf.st_ino;
 	}
 
 	lock2 = FbxLockEntry(fs, e, lockmode);
@@ -134,7 +134,7 @@ int FbxOpenFile(struct FbxFS *fs, struct FileHandle *fh, struct FbxLock *lock,
 		}
 		exists = TRUE;
 	} else {
-		error = Fbx_getattr(fs, fullpath, &statbuf);
+		error = FbxCachedGetAttr(fs, fullpath, &statbuf);
 		if (error == -ENOENT) {
 			exists = FALSE;
 		} else if (error == 0) {
@@ -201,6 +201,8 @@ int FbxOpenFile(struct FbxFS *fs, struct FileHandle *fh, struct FbxLock *lock,
 					return DOSFALSE;
 				}
 			}
+			FbxInvalidateNegative(fs, fullpath);
+			FbxInvalidateDirListingTree(fs, fullpath);
 			DEBUGF("FbxOpenFile: new file created ok\n");
 		}
 		break;
@@ -212,6 +214,9 @@ int FbxOpenFile(struct FbxFS *fs, struct FileHandle *fh, struct FbxLock *lock,
 	if (truncate) {
 		CHECKWRITABLE(DOSFALSE);
 		error = Fbx_truncate(fs, fullpath, 0);
+		if (e != NULL)
+			FbxInvalidateEntryAttr(fs, e);
+		FbxInvalidateDirListing(fs, fullpath);
 		if (error) {
 			fs->r2 = FbxFuseErrno2Error(error);
 			return DOSFALSE;
@@ -239,9 +244,18 @@ int FbxOpenFile(struct FbxFS *fs, struct FileHandle *fh, struct FbxLock *lock,
 	}
 
 	if (!exists || truncate) {
+		if (e->parent != NULL)
+			FbxInvalidateEntryAttr(fs, e->parent);
+		FbxInvalidateBlocks(fs, e->diskkey, 0);
+		e->filesize  = 0;
+		e->sizevalid = TRUE;
 		FbxTryResolveNotify(fs, e);
-		lock2->flags |= LOCKFLAG_MODIFIED;
-		FbxSetModifyState(fs, 1);
+		FbxSetFileModified(fs, lock2, 0);
+		if (!exists) {
+			// the new directory entry needs to be committed as well
+			if (FbxParentPath(fs, fullpath))
+				FbxSetPathModified(fs, fullpath);
+		}
 	}
 
 	fs->r2 = 0;
@@ -66,6 +66,10 @@ int FbxOpenLock(struct FbxFS *fs, struct FileHandle *fh, struct FbxLock *lock) {
 		return DOSFALSE;
 	}
 
+	// the file may have been changed since its blocks were cached
+	if (!lock->info->keep_cache)
+		FbxInvalidateBlocks(fs, lock->entry->diskkey, 0);
+
 	lock->fh = fh;
 	fh->fh_Arg1 = (SIPTR)MKBADDR(lock);
 
@@ -26,6 +26,7 @@ BOOL FbxParentPath(struct FbxFS *fs, char *pathbuf) {
 struct FbxLock *FbxLocateParent(struct FbxFS *fs, struct FbxLock *lock) {
 	char pname[FBX_MAX_PATH];
 	const char *name;
+	struct FbxEntry *e;
 
 	PDEBUGF("FbxLocateParent(%p, %p)\n", fs, lock);
 
@@ -43,6 +44,16 @@ struct FbxLock *FbxLocateParent(struct FbxFS *fs, struct FbxLock *lock) {
 		return NULL;
 	}
 
+	e = lock->entry->parent;
+	if (e != NULL && (e->diskkey != 0 || !(fs->fsflags & FBXF_USE_INO))) {
+		// parent directory entry is already set up
+		lock = FbxLockEntry(fs, e, SHARED_LOCK);
+		if (lock == NULL) return NULL;
+
+		fs->r2 = 0;
+		return lock;
+	}
+
 	FbxStrlcpy(fs, pname, lock->entry->path, FBX_MAX_PATH);
 	if (!FbxParentPath(fs, pname)) {
 		// can't parent root
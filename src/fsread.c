@@ -9,6 +9,8 @@
  */
 
 #include "filesysbox_internal.h"
+#include <errno.h>
+#include <string.h>
 
 static int Fbx_read(struct FbxFS *fs, const char *path, char *buf, size_t len,
 	QUAD offset, struct fuse_file_info *fi)
@@ -18,9 +20,308 @@ static int Fbx_read(struct FbxFS *fs, const char *path, char *buf, size_t len,
 	return FSOP read(path, buf, len, offset, fi, &fs->fcntx);
 }
 
-int FbxReadFile(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, int bytes) {
+static int Fbx_read_buf(struct FbxFS *fs, const char *path, struct fbx_bufvec *bufv, size_t len,
+	QUAD offset, struct fuse_file_info *fi)
+{
+	ODEBUGF("Fbx_read_buf(%p, '%s', %p, %zu, %lld, %p)\n", fs, path, bufv, len, (long long)offset, fi);
+
+	return FSOP read_buf(path, bufv, len, offset, fi, &fs->fcntx);
+}
+
+/* Reads from the file with read_buf() if the file system has it, in which
+ * case the data is copied from the segments that it returns, and with
+ * read() otherwise.
+ */
+static int FbxReadData(struct FbxFS *fs, const char *path, char *buf, size_t len,
+	QUAD offset, struct fuse_file_info *fi)
+{
+	struct Library *SysBase = fs->sysbase;
+	struct FbxBufVec bufv;
+	struct fbx_buf *seg = bufv.bv.buf;
+	size_t i, seglen, total = 0;
 	int res;
 
+	if (FSOP read_buf != NULL) {
+		bufv.bv.count = BUFVECMAXSEGS;
+		res = Fbx_read_buf(fs, path, &bufv.bv, len, offset, fi);
+		if (res != -ENOSYS) {
+			if (res <= 0)
+				return res;
+
+			if ((size_t)res > len)
+				res = len;
+			for (i = 0; i < bufv.bv.count && i < BUFVECMAXSEGS && total < (size_t)res; i++) {
+				seglen = min(seg[i].size, (size_t)res - total);
+				CopyMem(seg[i].mem, buf + total, seglen);
+				total += seglen;
+			}
+			return total;
+		}
+	}
+
+	return Fbx_read(fs, path, buf, len, offset, fi);
+}
+
+/* Reads from the file through the block cache. Runs of whole blocks that
+ * aren't cached are read with a single call directly into the buffer and
+ * then copied into the cache.
+ */
+static int FbxReadCached(struct FbxFS *fs, struct FbxLock *lock, UBYTE *buffer, int bytes, QUAD pos) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxEntry *e = lock->entry;
+	struct FbxBlock *block;
+	UQUAD index;
+	int offs, len, res, total = 0;
+	int i, nblocks;
+
+	if (!FbxUseBlockCache(fs, lock))
+		return FbxReadData(fs, e->path, (char *)buffer, bytes, pos, lock->info);
+
+	while (bytes > 0) {
+		index = pos / BLOCKCACHEBLOCKSIZE;
+		offs  = pos % BLOCKCACHEBLOCKSIZE;
+
+		block = FbxFindBlock(fs, e->diskkey, index);
+		if (block == NULL && offs == 0 && bytes >= BLOCKCACHEBLOCKSIZE) {
+			nblocks = 1;
+			while ((nblocks + 1) * BLOCKCACHEBLOCKSIZE <= bytes &&
+				FbxFindBlock(fs, e->diskkey, index + nblocks) == NULL)
+			{
+				nblocks++;
+			}
+
+			res = FbxReadData(fs, e->path, (char *)buffer, nblocks * BLOCKCACHEBLOCKSIZE, pos, lock->info);
+			if (res < 0) {
+				if (total != 0) break;
+				return res;
+			}
+
+			for (i = 0; i < nblocks && (i * BLOCKCACHEBLOCKSIZE) < res; i++) {
+				block = FbxAllocBlock(fs);
+				if (block == NULL) break;
+				offs = i * BLOCKCACHEBLOCKSIZE;
+				len = min(res - offs, BLOCKCACHEBLOCKSIZE);
+				CopyMem(buffer + offs, block->data, len);
+				if (!FbxInsertBlock(fs, block, e->diskkey, index + i, len)) break;
+			}
+
+			buffer += res;
+			bytes -= res;
+			total += res;
+			pos += res;
+			if (res < (nblocks * BLOCKCACHEBLOCKSIZE)) break; // end of file
+			continue;
+		}
+
+		if (block == NULL) {
+			block = FbxAllocBlock(fs);
+			if (block != NULL) {
+				res = FbxReadData(fs, e->path, (char *)block->data, BLOCKCACHEBLOCKSIZE,
+					index * BLOCKCACHEBLOCKSIZE, lock->info);
+				if (res < 0) {
+					FbxFreeBlock(fs, block);
+					if (total != 0) break;
+					return res;
+				}
+				if (!FbxInsertBlock(fs, block, e->diskkey, index, res))
+					block = NULL;
+			}
+			if (block == NULL) {
+				// out of memory, do the rest of the read without caching
+				res = FbxReadData(fs, e->path, (char *)buffer, bytes, pos, lock->info);
+				if (res < 0) {
+					if (total != 0) break;
+					return res;
+				}
+				total += res;
+				break;
+			}
+		}
+
+		if (offs >= block->len) break; // end of file
+
+		len = min(block->len - offs, bytes);
+		CopyMem(block->data + offs, buffer, len);
+		buffer += len;
+		bytes -= len;
+		total += len;
+		pos += len;
+	}
+
+	return total;
+}
+
+/* Serves a small read from the read buffer of the lock, refilling it
+ * with one large read from the file system when needed.
+ */
+static int FbxReadBuffered(struct FbxFS *fs, struct FbxLock *lock, UBYTE *buffer, int bytes) {
+	struct Library *SysBase = fs->sysbase;
+	QUAD pos = lock->filepos;
+	QUAD offs;
+	int res, len, total = 0;
+
+	while (bytes > 0) {
+		offs = pos - lock->rbufpos;
+		if (offs < 0 || offs >= lock->rbuflen) {
+			lock->rbuflen = 0;
+			res = FbxReadCached(fs, lock, lock->rbuf, fs->rbufsize, pos);
+			if (res < 0) {
+				if (total != 0) break;
+				return res;
+			}
+			lock->rbufpos = pos;
+			lock->rbuflen = res;
+			if (res == 0) break; // end of file
+			offs = 0;
+		}
+
+		len = min(lock->rbuflen - offs, bytes);
+		CopyMem(lock->rbuf + offs, buffer, len);
+		buffer += len;
+		bytes -= len;
+		total += len;
+		pos += len;
+	}
+
+	return total;
+}
+
+/* Must be called whenever the contents of the file are changed */
+void FbxInvalidateReadBuffers(struct FbxFS *fs, struct FbxEntry *e) {
+	struct MinNode *chain, *succ;
+	struct FbxLock *lock;
+
+	for (chain = e->locklist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		lock = FSLOCKFROMENTRYCHAIN(chain);
+		lock->rbuflen  = 0;
+		lock->rabuflen = 0;
+		lock->raeof    = FALSE;
+	}
+}
+
+/* Readahead. Locks that are read sequentially get a readahead window that
+ * starts at RAMINWINDOW bytes and is doubled each time it is filled, up to
+ * fs->rasize bytes. As the file system is not reentrant the window is not
+ * filled by a separate process but by the event loop when there are no
+ * packets waiting, so that it is done while the application is busy with
+ * the data it already got. A new fill is queued once less than half of the
+ * window is left to be read.
+ */
+
+void FbxCancelReadahead(struct FbxFS *fs, struct FbxLock *lock) {
+	struct Library *SysBase = fs->sysbase;
+
+	if (RAPENDING(lock)) {
+		Remove((struct Node *)&lock->rachain);
+		lock->rachain.mln_Succ = NULL;
+	}
+}
+
+/* Serves as much as possible of a read from the readahead buffer */
+static int FbxReadAheadBuffer(struct FbxFS *fs, struct FbxLock *lock, UBYTE *buffer, int bytes) {
+	struct Library *SysBase = fs->sysbase;
+	QUAD offs = lock->filepos - lock->rabufpos;
+	int len;
+
+	if (offs < 0 || offs >= lock->rabuflen)
+		return 0;
+
+	len = min(lock->rabuflen - offs, bytes);
+	CopyMem(lock->rabuf + offs, buffer, len);
+	return len;
+}
+
+/* Updates the readahead state after a read of bytes at pos */
+static void FbxUpdateReadahead(struct FbxFS *fs, struct FbxLock *lock, QUAD pos, int bytes) {
+	struct Library *SysBase = fs->sysbase;
+	QUAD ahead;
+
+	if (pos != lock->ranext) {
+		// not sequential
+		lock->rawindow = 0;
+		lock->rabuflen = 0;
+		lock->raeof    = FALSE;
+		FbxCancelReadahead(fs, lock);
+	} else if (lock->rawindow == 0) {
+		lock->rawindow = min(max(bytes * 2, RAMINWINDOW), fs->rasize);
+	}
+
+	lock->ranext = pos + bytes;
+
+	if (lock->rawindow == 0 || lock->raeof || RAPENDING(lock))
+		return;
+
+	ahead = lock->rabufpos + lock->rabuflen - lock->ranext;
+	if (ahead < (lock->rawindow / 2))
+		AddTail((struct List *)&lock->fsvol->ralist, (struct Node *)&lock->rachain);
+}
+
+BOOL FbxReadaheadPending(struct FbxFS *fs) {
+	return OKVOLUME(fs->currvol) && !IsMinListEmpty(&fs->currvol->ralist);
+}
+
+/* Fills the readahead window of the first lock waiting for it */
+void FbxDoReadahead(struct FbxFS *fs) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxLock *lock;
+	struct MinNode *chain;
+	QUAD pos, keep;
+	int len, res;
+
+	if (!FbxReadaheadPending(fs))
+		return;
+
+	chain = (struct MinNode *)RemHead((struct List *)&fs->currvol->ralist);
+	chain->mln_Succ = NULL;
+	lock = FSLOCKFROMRACHAIN(chain);
+
+	if (lock->info == NULL || lock->info->direct_io)
+		return;
+
+	if (lock->rabuf == NULL) {
+		lock->rabuf = AllocVecPooled(fs->mempool, fs->rasize);
+		if (lock->rabuf == NULL) {
+			lock->rawindow = 0;
+			return;
+		}
+	}
+
+	// buffered writes must be seen
+	FbxFlushWriteBuffers(fs, lock->entry);
+
+	// keep what is left to be read of the previous window
+	pos  = lock->ranext;
+	keep = lock->rabufpos + lock->rabuflen - pos;
+	if (keep > 0 && pos >= lock->rabufpos)
+		memmove(lock->rabuf, lock->rabuf + (pos - lock->rabufpos), keep);
+	else
+		keep = 0;
+	lock->rabufpos = pos;
+	lock->rabuflen = keep;
+
+	len = lock->rawindow - keep;
+	if (len <= 0)
+		return;
+
+	res = FbxReadCached(fs, lock, lock->rabuf + keep, len, pos + keep);
+	if (res < 0) {
+		// the error is left for the application's own read to report
+		lock->rawindow = 0;
+		return;
+	}
+
+	lock->rabuflen += res;
+	if (res < len)
+		lock->raeof = TRUE;
+	else
+		lock->rawindow = min(lock->rawindow * 2, fs->rasize);
+}
+
+int FbxReadFile(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, int bytes) {
+	struct Library *SysBase = fs->sysbase;
+	QUAD pos;
+	int res, done;
+
 	PDEBUGF("FbxReadFile(%p, %p, %p, %d)\n", fs, lock, buffer, bytes);
 
 	if (lock != NULL) {
@@ -40,13 +341,48 @@ int FbxReadFile(struct FbxFS *fs, struct FbxLock *lock, APTR buffer, int bytes)
 		return 0;
 	}
 
-	res = Fbx_read(fs, lock->entry->path, buffer, bytes, lock->filepos, lock->info);
+	// data written through any handle must be visible
+	FbxFlushWriteBuffers(fs, lock->entry);
+	if (lock->wbuferr != 0) {
+		fs->r2 = FbxFuseErrno2Error(FbxCommitWriteBuffer(fs, lock));
+		return -1;
+	}
+
+	// serve what has been read ahead first
+	pos = lock->filepos;
+	done = FbxReadAheadBuffer(fs, lock, buffer, bytes);
+	lock->filepos += done;
+	buffer = (UBYTE *)buffer + done;
+	bytes -= done;
+	if (bytes == 0) {
+		if (fs->rasize != 0 && !lock->info->direct_io)
+			FbxUpdateReadahead(fs, lock, pos, done);
+		fs->r2 = 0;
+		return done;
+	}
+
+	if (bytes < fs->rbufsize && lock->rbuf == NULL && !lock->info->direct_io) {
+		// if this fails the read is simply done without buffering
+		lock->rbuf = AllocVecPooled(fs->mempool, fs->rbufsize);
+	}
+
+	if (bytes < fs->rbufsize && lock->rbuf != NULL)
+		res = FbxReadBuffered(fs, lock, buffer, bytes);
+	else
+		res = FbxReadCached(fs, lock, buffer, bytes, lock->filepos);
 	if (res < 0) {
+		if (done != 0) {
+			fs->r2 = 0;
+			return done;
+		}
 		fs->r2 = FbxFuseErrno2Error(res);
 		return -1;
 	}
 
 	lock->filepos += res;
+	res += done;
+	if (fs->rasize != 0 && !lock->info->direct_io)
+		FbxUpdateReadahead(fs, lock, pos, res);
 	fs->r2 = 0;
 	return res;
 }
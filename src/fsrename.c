@@ -20,37 +20,52 @@ static int Fbx_rename(struct FbxFS *fs, const char *path, const char *path2)
 	return FSOP rename(path, path2, &fs->fcntx);
 }
 
-static void FbxUpdatePaths(struct FbxFS *fs, const char *oldpath, const char *newpath) {
-	struct Library *SysBase = fs->sysbase;
+/* Rebuilds the paths of all cached entries below e from the path of their
+ * parent directory entry. The tree is traversed in pre-order so that the
+ * path of a parent is always updated before those of its children. If an
+ * entry (or e itself) couldn't be renamed, the entries below it are
+ * detached as well, as their paths can't be built from its stale one.
+ */
+static void FbxUpdatePaths(struct FbxFS *fs, struct FbxEntry *root) {
 	char tstr[FBX_MAX_PATH];
-	struct MinNode *chain, *succ;
+	struct MinNode *chain;
+	struct FbxEntry *e, *stale = NULL;
 
 	// TODO: unresolve+tryresolve notify for affected entries..
 
-	// let's rename all subentries. subentries can be
-	// found by comparing common path. do this by traversing
-	// global hashtable and compare entry->path
-	size_t n = IsRoot(oldpath) ? 0 : FbxCharCount(fs, oldpath);
-	int a;
-	for (a = 0; a < ENTRYHASHSIZE; a++) {
-		for (chain = fs->currvol->entrytab[a].mlh_Head;
-			(succ = chain->mln_Succ) != NULL;
-			chain = succ)
-		{
-			struct FbxEntry *e = FSENTRYFROMHASHCHAIN(chain);
-			char *subpath;
-			if (FbxStrncmp(fs, oldpath, e->path, n) == 0 &&
-			    *(subpath = FbxCharPtr(fs, e->path, n)) == '/')
-			{
-				// match! let's update path
-				FbxStrlcpy(fs, tstr, newpath, FBX_MAX_PATH);
-				FbxStrlcat(fs, tstr, subpath, FBX_MAX_PATH);
-				FbxSetEntryPath(fs, e, tstr);
-				// and rehash it
-				Remove((struct Node *)&e->hashchain);
-				FbxAddEntry(fs, e);
-			}
+	if (ENTRYDETACHED(root))
+		stale = root;
+
+	chain = root->children.mlh_Head;
+	while (chain->mln_Succ != NULL) {
+		e = FSENTRYFROMSIBLING(chain);
+
+		if (stale != NULL) {
+			FbxDetachEntry(fs, e);
+		} else {
+			FbxStrlcpy(fs, tstr, e->parent->path, FBX_MAX_PATH);
+			if (!IsRoot(tstr))
+				FbxStrlcat(fs, tstr, "/", FBX_MAX_PATH);
+			FbxStrlcat(fs, tstr, strrchr(e->path, '/') + 1, FBX_MAX_PATH);
+			if (!FbxRenameEntry(fs, e, tstr))
+				stale = e;
 		}
+
+		if (!IsMinListEmpty(&e->children)) {
+			chain = e->children.mlh_Head;
+			continue;
+		}
+
+		// go to the next sibling, or that of the closest parent that has one
+		while (e != root && chain->mln_Succ->mln_Succ == NULL) {
+			if (e == stale) stale = NULL;
+			e = e->parent;
+			chain = &e->sibling;
+		}
+		if (e == root)
+			break;
+		if (e == stale) stale = NULL;
+		chain = chain->mln_Succ;
 	}
 }
 
@@ -58,8 +73,8 @@ int FbxRenameObject(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 	struct FbxLock *lock2, const char *name2)
 {
 	struct Library *SysBase = fs->sysbase;
-	struct FbxEntry *e, *e2;
-	struct fbx_stat statbuf;
+	struct FbxEntry *e, *e2, *parent = NULL;
+	struct fbx_stat statbuf, statbuf2;
 	int error;
 	char fullpath[FBX_MAX_PATH];
 	char fullpath2[FBX_MAX_PATH];
@@ -156,7 +171,7 @@ int FbxRenameObject(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 			fs->r2 = ERROR_OBJECT_EXISTS;
 			return DOSFALSE;
 		}
-		error = Fbx_getattr(fs, fullpath2, &statbuf);
+		error = FbxCachedGetAttr(fs, fullpath2, &statbuf2);
 		if (error == 0) {
 			fs->r2 = ERROR_OBJECT_EXISTS;
 			return DOSFALSE;
@@ -166,27 +181,58 @@ int FbxRenameObject(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		}
 	}
 
+	if (e != NULL) {
+		/* Entry for the new parent directory */
+		parent = FbxObtainParentEntry(fs, fullpath2);
+		if (parent == NULL) {
+			fs->r2 = ERROR_NO_FREE_STORE;
+			return DOSFALSE;
+		}
+	}
+
+	// queued archive flag clears refer to the old paths
+	FbxFlushArchiveFlags(fs);
+
 	error = Fbx_rename(fs, fullpath, fullpath2);
 	if (error) {
+		FbxCleanupEntry(fs, parent);
 		fs->r2 = FbxFuseErrno2Error(error);
 		return DOSFALSE;
 	}
 
+	FbxFlushPathCache(fs, &fs->currvol->archcleared);
+
+	if ((e != NULL) ? (e->type == ETYPE_DIR) : S_ISDIR(statbuf.st_mode)) {
+		// anything below the new path may exist now
+		FbxFlushPathCache(fs, &fs->currvol->negcache);
+	} else {
+		FbxInvalidateNegative(fs, fullpath2);
+	}
+
+	FbxInvalidateDirListingTree(fs, fullpath);
+	FbxInvalidateDirListingTree(fs, fullpath2);
+
 	FbxDoNotify(fs, fullpath);
 
 	//e = FbxFindEntry(fs, fullpath); /* Already done in code above */
 	if (e != NULL) {
+		struct FbxEntry *oldparent = e->parent;
+
 		FbxUnResolveNotifys(fs, e);
-		FbxSetEntryPath(fs, e, fullpath2);
-		Remove((struct Node *)&e->hashchain);
-		FbxAddEntry(fs, e);
+		Remove((struct Node *)&e->sibling);
+		AddTail((struct List *)&parent->children, (struct Node *)&e->sibling);
+		e->parent = parent;
+		FbxRenameEntry(fs, e, fullpath2);
 		FbxTryResolveNotify(fs, e);
+
+		// only the subtree below the renamed entry needs updating
+		FbxUpdatePaths(fs, e);
+
+		FbxCleanupEntry(fs, oldparent);
 	}
 
 	FbxDoNotify(fs, fullpath2);
 
-	FbxUpdatePaths(fs, fullpath, fullpath2);
-
 	FbxSetModifyState(fs, 1);
 
 	fs->r2 = 0;
@@ -12,12 +12,19 @@
 
 QUAD FbxSeekFile64(struct FbxFS *fs, struct FbxLock *lock, QUAD pos, int mode) {
 	QUAD newpos, oldpos, size;
+	int error;
 
 	PDEBUGF("FbxSeekFile(%p, %p, %lld, %d)\n", fs, lock, (long long)pos, mode);
 
 	oldpos = FbxGetFilePosition(fs, lock);
 	if (oldpos == -1) return -1;
 
+	error = FbxCommitWriteBuffer(fs, lock);
+	if (error) {
+		fs->r2 = FbxFuseErrno2Error(error);
+		return -1;
+	}
+
 	size = FbxGetFileSize(fs, lock);
 	if (size == -1) return -1;
 
@@ -41,6 +48,10 @@ QUAD FbxSeekFile64(struct FbxFS *fs, struct FbxLock *lock, QUAD pos, int mode) {
 		return -1;
 	}
 
+	// drop read buffer if the new position is outside of it
+	if (newpos < lock->rbufpos || newpos > (lock->rbufpos + lock->rbuflen))
+		lock->rbuflen = 0;
+
 	lock->filepos = newpos;
 	fs->r2 = 0;
 	return oldpos;
@@ -76,6 +76,8 @@ int FbxSetComment(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		return DOSFALSE;
 	}
 
+	FbxInvalidatePathXattrs(fs, fullpath);
+
 	FbxSetModifyState(fs, 1);
 
 	fs->r2 = 0;
@@ -102,6 +102,7 @@ int FbxSetDate(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		return DOSFALSE;
 	}
 
+	FbxInvalidatePathAttr(fs, fullpath);
 	FbxDoNotify(fs, fullpath);
 
 	FbxSetModifyState(fs, 1);
@@ -9,6 +9,8 @@
  */
 
 #include "filesysbox_internal.h"
+#include "fuse_stubs.h"
+#include <errno.h>
 
 static int Fbx_ftruncate(struct FbxFS *fs, const char *path, QUAD size, struct fuse_file_info *fi)
 {
@@ -44,6 +46,14 @@ QUAD FbxSetFileSize64(struct FbxFS *fs, struct FbxLock *lock, QUAD offs, int mod
 	oldsize = FbxGetFileSize(fs, lock);
 	if (oldsize == -1) return -1;
 
+	// buffered writes must not end up beyond the new size
+	FbxFlushWriteBuffers(fs, lock->entry);
+	error = FbxCommitWriteBuffer(fs, lock);
+	if (error) {
+		fs->r2 = FbxFuseErrno2Error(error);
+		return -1;
+	}
+
 	switch (mode) {
 	case OFFSET_BEGINNING:
 		newsize = offs;
@@ -77,14 +87,26 @@ QUAD FbxSetFileSize64(struct FbxFS *fs, struct FbxLock *lock, QUAD offs, int mod
 	 * if so, truncate position to new filesize.. */
 	if (lock->filepos > newsize) lock->filepos = newsize;
 
-	error = Fbx_ftruncate(fs, lock->entry->path, newsize, lock->info);
+	error = -ENOSYS;
+	if (newsize > oldsize && FSOP fallocate != NULL) {
+		// lets the file system allocate the new space in one go
+		error = Fbx_fallocate(fs, lock->entry->path, 0, oldsize, newsize - oldsize, lock->info);
+	}
+	if (error == -ENOSYS || error == -EOPNOTSUPP)
+		error = Fbx_ftruncate(fs, lock->entry->path, newsize, lock->info);
+	FbxInvalidateBlocks(fs, lock->entry->diskkey, min(oldsize, newsize));
+	FbxInvalidateEntryAttr(fs, lock->entry);
+	FbxInvalidateReadBuffers(fs, lock->entry);
 	if (error) {
+		lock->entry->sizevalid = FALSE;
 		fs->r2 = FbxFuseErrno2Error(error);
 		return -1;
 	}
 
-	lock->flags |= LOCKFLAG_MODIFIED; /* for notification */
-	FbxSetModifyState(fs, 1);
+	lock->entry->filesize  = newsize;
+	lock->entry->sizevalid = TRUE;
+
+	FbxSetFileModified(fs, lock, 0);
 
 	fs->r2 = 0;
 	return newsize;
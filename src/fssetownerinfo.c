@@ -68,6 +68,8 @@ int FbxSetOwnerInfo(struct FbxFS *fs, struct FbxLock *lock, const char *name,
 		return DOSFALSE;
 	}
 
+	FbxInvalidatePathAttr(fs, fullpath);
+
 	FbxSetModifyState(fs, 1);
 
 	fs->r2 = 0;
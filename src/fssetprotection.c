@@ -36,6 +36,7 @@ static mode_t FbxProtection2Mode(ULONG prot) {
 }
 
 int FbxSetProtection(struct FbxFS *fs, struct FbxLock *lock, const char *name, ULONG prot) {
+	struct FbxPathNode *pn;
 	int error;
 	char fullpath[FBX_MAX_PATH];
 #ifdef ENABLE_CHARSET_CONVERSION
@@ -72,12 +73,21 @@ int FbxSetProtection(struct FbxFS *fs, struct FbxLock *lock, const char *name, U
 		return DOSFALSE;
 	}
 
+	// an explicitly set archive flag must not be cleared later on
+	pn = FbxFindPathNode(fs, &fs->currvol->archpending, fullpath);
+	if (pn != NULL)
+		FbxRemovePathNode(fs, &fs->currvol->archpending, pn);
+	if (prot & FIBF_ARCHIVE)
+		FbxFlushPathCache(fs, &fs->currvol->archcleared);
+
 	error = Fbx_chmod(fs, fullpath, FbxProtection2Mode(prot));
 	if (error) {
 		fs->r2 = FbxFuseErrno2Error(error);
 		return DOSFALSE;
 	}
 
+	FbxInvalidatePathAttr(fs, fullpath);
+
 	error = FbxSetAmigaProtectionFlags(fs, fullpath, prot);
 	if (error && (error != -ENOSYS && error != -EOPNOTSUPP)) {
 		fs->r2 = FbxFuseErrno2Error(error);
@@ -9,6 +9,8 @@
  */
 
 #include "filesysbox_internal.h"
+#include "fuse_stubs.h"
+#include <errno.h>
 
 static int Fbx_write(struct FbxFS *fs, const char *path, const char *buf, size_t len,
 	QUAD offset, struct fuse_file_info *fi)
@@ -18,10 +20,228 @@ static int Fbx_write(struct FbxFS *fs, const char *path, const char *buf, size_t
 	return FSOP write(path, buf, len, offset, fi, &fs->fcntx);
 }
 
-int FbxWriteFile(struct FbxFS *fs, struct FbxLock *lock, CONST_APTR buffer, int bytes) {
+static int Fbx_write_buf(struct FbxFS *fs, const char *path, const struct fbx_bufvec *bufv,
+	QUAD offset, struct fuse_file_info *fi)
+{
+	ODEBUGF("Fbx_write_buf(%p, '%s', %p, %lld, %p)\n", fs, path, bufv, (long long)offset, fi);
+
+	return FSOP write_buf(path, bufv, offset, fi, &fs->fcntx);
+}
+
+/* Writes the segments of bufv one after the other to the file at offset.
+ * This is done with a single write_buf() call if the file system has it
+ * and with one write() call for each segment otherwise. Returns the number
+ * of bytes written or a negative error code.
+ */
+static int FbxWriteBufVec(struct FbxFS *fs, const char *path, const struct fbx_bufvec *bufv,
+	QUAD offset, struct fuse_file_info *fi)
+{
+	size_t i;
+	int res, total = 0;
+
+	if (FSOP write_buf != NULL) {
+		res = Fbx_write_buf(fs, path, bufv, offset, fi);
+		if (res != -ENOSYS)
+			return res;
+	}
+
+	for (i = 0; i < bufv->count; i++) {
+		res = Fbx_write(fs, path, bufv->buf[i].mem, bufv->buf[i].size, offset + total, fi);
+		if (res < 0) {
+			if (total != 0) break;
+			return res;
+		}
+		total += res;
+		if (res != bufv->buf[i].size) break;
+	}
+
+	return total;
+}
+
+static int FbxWriteData(struct FbxFS *fs, const char *path, const char *buf, size_t len,
+	QUAD offset, struct fuse_file_info *fi)
+{
+	struct fbx_bufvec bufv;
+
+	if (FSOP write_buf == NULL)
+		return Fbx_write(fs, path, buf, len, offset, fi);
+
+	bufv.count       = 1;
+	bufv.buf[0].size = len;
+	bufv.buf[0].mem  = (void *)buf;
+	return FbxWriteBufVec(fs, path, &bufv, offset, fi);
+}
+
+/* Writes out the contents of the write buffer of a lock. If this fails the
+ * error is remembered and reported by the next operation on the lock.
+ */
+void FbxFlushWriteBuffer(struct FbxFS *fs, struct FbxLock *lock) {
 	int res;
 
-	PDEBUGF("FbxWriteFile(%p, %p, %p, %d)\n", fs, lock, buffer, bytes);
+	if (lock->wbuflen == 0)
+		return;
+
+	res = FbxWriteData(fs, lock->entry->path, (const char *)lock->wbuf, lock->wbuflen,
+		lock->wbufpos, lock->info);
+	FbxInvalidateBlockRange(fs, lock->entry->diskkey, lock->wbufpos, lock->wbuflen);
+	if (res != lock->wbuflen) {
+		lock->entry->sizevalid = FALSE;
+		if (lock->wbuferr == 0)
+			lock->wbuferr = (res < 0) ? res : -EIO;
+	}
+
+	lock->wbuflen = 0;
+}
+
+/* Flushes the write buffer of a lock and returns (and clears) the error
+ * of any failed write
+ */
+int FbxCommitWriteBuffer(struct FbxFS *fs, struct FbxLock *lock) {
+	int error;
+
+	FbxFlushWriteBuffer(fs, lock);
+
+	error = lock->wbuferr;
+	lock->wbuferr = 0;
+	return error;
+}
+
+/* Must be called before the file system is asked about the contents or
+ * the size of the file
+ */
+void FbxFlushWriteBuffers(struct FbxFS *fs, struct FbxEntry *e) {
+	struct MinNode *chain, *succ;
+
+	for (chain = e->locklist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		FbxFlushWriteBuffer(fs, FSLOCKFROMENTRYCHAIN(chain));
+	}
+}
+
+/* Flushes the write buffers of the files in the directory of entry dir, so
+ * that reading the directory returns their current sizes
+ */
+void FbxFlushDirWriteBuffers(struct FbxFS *fs, struct FbxEntry *dir) {
+	struct MinNode *chain, *succ;
+
+	for (chain = dir->children.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		FbxFlushWriteBuffers(fs, FSENTRYFROMSIBLING(chain));
+	}
+}
+
+void FbxFlushAllWriteBuffers(struct FbxFS *fs) {
+	struct MinNode *chain, *succ;
+
+	for (chain = fs->currvol->locklist.mlh_Head; (succ = chain->mln_Succ) != NULL; chain = succ) {
+		FbxFlushWriteBuffer(fs, FSLOCKFROMVOLUMECHAIN(chain));
+	}
+}
+
+/* Adds a small write at offset to the write buffer of the lock */
+static int FbxWriteBuffered(struct FbxFS *fs, struct FbxLock *lock, CONST_APTR buffer, int bytes,
+	QUAD offset)
+{
+	struct Library *SysBase = fs->sysbase;
+	int error;
+
+	// only contiguous writes can be combined
+	if (lock->wbuflen != 0 &&
+		(offset != (lock->wbufpos + lock->wbuflen) ||
+		(lock->wbuflen + bytes) > fs->wbufsize))
+	{
+		error = FbxCommitWriteBuffer(fs, lock);
+		if (error) return error;
+	}
+
+	if (lock->wbuflen == 0)
+		lock->wbufpos = offset;
+
+	CopyMem((APTR)buffer, lock->wbuf + lock->wbuflen, bytes);
+	lock->wbuflen += bytes;
+
+	if (lock->wbuflen == fs->wbufsize) {
+		error = FbxCommitWriteBuffer(fs, lock);
+		if (error) return error;
+	}
+
+	return bytes;
+}
+
+/* Preallocates space beyond the end of file once a file is being appended
+ * to with consecutive writes, so that the file system doesn't need to
+ * allocate space for each write. The preallocation is doubled each time
+ * up to PREALLOCMAXSIZE bytes, and any unused part is freed again by
+ * FbxTrimPreallocation() when the file is closed.
+ */
+static void FbxPreallocate(struct FbxFS *fs, struct FbxLock *lock, int bytes) {
+	struct FbxEntry *e = lock->entry;
+	QUAD start, end, len;
+	int error;
+
+	if (!e->sizevalid || lock->filepos != e->filesize) {
+		lock->appendcount = 0;
+		return;
+	}
+
+	if (++lock->appendcount < PREALLOCMINAPPENDS)
+		return;
+
+	end = lock->filepos + bytes;
+	if (end <= lock->preallocend)
+		return;
+
+	if (lock->preallocsize == 0)
+		lock->preallocsize = PREALLOCMINSIZE;
+	else
+		lock->preallocsize = min(lock->preallocsize * 2, PREALLOCMAXSIZE);
+
+	start = max(lock->preallocend, lock->filepos);
+	len = max((QUAD)lock->preallocsize, end - start);
+
+	error = Fbx_fallocate(fs, e->path, FBX_FALLOC_KEEP_SIZE, start, len, lock->info);
+	if (error) {
+		lock->flags |= LOCKFLAG_NOPREALLOC;
+		return;
+	}
+
+	lock->preallocend = start + len;
+}
+
+/* Frees space preallocated by FbxPreallocate() beyond the end of file */
+void FbxTrimPreallocation(struct FbxFS *fs, struct FbxLock *lock) {
+	struct FbxEntry *e = lock->entry;
+	struct fbx_stat statbuf;
+	QUAD size;
+
+	if (lock->preallocend == 0)
+		return;
+
+	if (e->sizevalid) {
+		size = e->filesize;
+	} else {
+		if (FbxGetEntryAttr(fs, e, &statbuf, lock->info) != 0)
+			return;
+		size = statbuf.st_size;
+	}
+
+	if (lock->preallocend > size) {
+		Fbx_fallocate(fs, e->path, FBX_FALLOC_PUNCH_HOLE|FBX_FALLOC_KEEP_SIZE,
+			size, lock->preallocend - size, lock->info);
+	}
+
+	lock->preallocend  = 0;
+	lock->preallocsize = 0;
+}
+
+/* Writes the segments of bufv, bytes in total, to the file of the lock at
+ * the current position, as if they were written one after the other.
+ */
+int FbxWriteFileVec(struct FbxFS *fs, struct FbxLock *lock, const struct fbx_bufvec *bufv, int bytes) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxEntry *e;
+	size_t i;
+	int res;
+
+	PDEBUGF("FbxWriteFileVec(%p, %p, %p, %d)\n", fs, lock, bufv, bytes);
 
 	if (lock != NULL) {
 		CHECKLOCK(lock, -1);
@@ -42,19 +262,71 @@ int FbxWriteFile(struct FbxFS *fs, struct FbxLock *lock, CONST_APTR buffer, int
 		return 0;
 	}
 
-	res = Fbx_write(fs, lock->entry->path, buffer, bytes, lock->filepos, lock->info);
+	e = lock->entry;
+
+	// report errors from deferred writes
+	if (lock->wbuferr != 0) {
+		fs->r2 = FbxFuseErrno2Error(FbxCommitWriteBuffer(fs, lock));
+		return -1;
+	}
+
+	if (FSOP fallocate != NULL && !(lock->flags & LOCKFLAG_NOPREALLOC))
+		FbxPreallocate(fs, lock, bytes);
+
+	if (bytes < fs->wbufsize && lock->wbuf == NULL && !lock->info->direct_io) {
+		// if this fails the write is simply done without buffering
+		lock->wbuf = AllocVecPooled(fs->mempool, fs->wbufsize);
+	}
+
+	if (bytes < fs->wbufsize && lock->wbuf != NULL) {
+		res = 0;
+		for (i = 0; i < bufv->count; i++) {
+			int len = FbxWriteBuffered(fs, lock, bufv->buf[i].mem, bufv->buf[i].size,
+				lock->filepos + res);
+			if (len < 0) {
+				// report it with the next operation if some data was taken
+				if (res == 0)
+					res = len;
+				else
+					lock->wbuferr = len;
+				break;
+			}
+			res += len;
+		}
+	} else {
+		// keep the writes in order
+		res = FbxCommitWriteBuffer(fs, lock);
+		if (res == 0) {
+			res = FbxWriteBufVec(fs, e->path, bufv, lock->filepos, lock->info);
+			FbxInvalidateBlockRange(fs, e->diskkey, lock->filepos, bytes);
+		}
+	}
+	FbxInvalidateEntryAttr(fs, e);
+	FbxInvalidateReadBuffers(fs, e);
 	if (res < 0) {
+		e->sizevalid = FALSE;
 		fs->r2 = FbxFuseErrno2Error(res);
 		return -1;
 	}
 
 	if (res > 0) {
-		lock->filepos += bytes;
-		lock->flags |= LOCKFLAG_MODIFIED; // for notification
-		FbxSetModifyState(fs, 1);
+		lock->filepos += res;
+		if (e->sizevalid && lock->filepos > e->filesize)
+			e->filesize = lock->filepos;
+		FbxSetFileModified(fs, lock, res);
 	}
 
 	fs->r2 = (res == bytes) ? 0 : -1;
 	return res;
 }
 
+int FbxWriteFile(struct FbxFS *fs, struct FbxLock *lock, CONST_APTR buffer, int bytes) {
+	struct fbx_bufvec bufv;
+
+	PDEBUGF("FbxWriteFile(%p, %p, %p, %d)\n", fs, lock, buffer, bytes);
+
+	bufv.count       = 1;
+	bufv.buf[0].size = bytes;
+	bufv.buf[0].mem  = (void *)buffer;
+	return FbxWriteFileVec(fs, lock, &bufv, bytes);
+}
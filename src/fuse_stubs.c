@@ -63,3 +63,10 @@ int Fbx_removexattr(struct FbxFS *fs, const char *path, const char *attr)
 	return FSOP removexattr(path, attr, &fs->fcntx);
 }
 
+int Fbx_fallocate(struct FbxFS *fs, const char *path, int mode, QUAD offset, QUAD len,
+	struct fuse_file_info *fi)
+{
+	ODEBUGF("Fbx_fallocate(%p, '%s', %d, %lld, %lld, %p)\n", fs, path, mode, (long long)offset, (long long)len, fi);
+
+	return FSOP fallocate(path, mode, offset, len, fi, &fs->fcntx);
+}
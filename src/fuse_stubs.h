@@ -21,6 +21,8 @@ int Fbx_setxattr(struct FbxFS *fs, const char *path, const char *attr,
 int Fbx_getxattr(struct FbxFS *fs, const char *path, const char *attr,
 	APTR buf, size_t len);
 int Fbx_removexattr(struct FbxFS *fs, const char *path, const char *attr);
+int Fbx_fallocate(struct FbxFS *fs, const char *path, int mode, QUAD offset, QUAD len,
+	struct fuse_file_info *fi);
 
 #endif /* FUSE_STUBS_H */
 
@@ -161,14 +161,19 @@ static int FbxLockHandlerProc(void) {
 						exallstate = (struct FbxExAllState *)ctrl->eac_LastKey;
 						if (exallstate) {
 							if (exallstate != (APTR)-1) {
-								FreeFbxDirDataList(lock, &exallstate->freelist);
+								FbxFreeDirBuffer(lock, &exallstate->strings);
 								FreeFbxExAllState(lock, exallstate);
 							}
 							ctrl->eac_LastKey = (IPTR)NULL;
 						}
 					}
 
-					if (lock != NULL) FreeFbxDirDataList(lock, &lock->dirdatalist);
+					if (lock != NULL) {
+						FbxFreeDirBuffer(lock, &lock->dirbuf);
+						FbxEndDirListing(lock);
+						// the filter was part of the freed state
+						lock->dirfilter = NULL;
+					}
 
 					r1 = DOSTRUE;
 					r2 = 0;
@@ -116,7 +116,20 @@ LONG FbxEventLoop(
 		}
 
 		const ULONG usigs = fs->signalcallbacksignals;
-		const ULONG rsigs = Wait(wsigs | usigs);
+		ULONG rsigs;
+
+		if (FbxReadaheadPending(fs)) {
+			// only do readahead while there is nothing else to do
+			rsigs = SetSignal(0, wsigs | usigs) & (wsigs | usigs);
+			if (rsigs == 0) {
+				ObtainSemaphore(&fs->fssema);
+				FbxDoReadahead(fs);
+				ReleaseSemaphore(&fs->fssema);
+				continue;
+			}
+		} else {
+			rsigs = Wait(wsigs | usigs);
+		}
 
 #ifndef NODEBUG
 		if (rsigs & dbgflagssig) FbxReadDebugFlags(fs);
@@ -186,10 +199,122 @@ static void FbxReturnPacket64(struct FbxFS *fs, struct DosPacket64 *pkt, QUAD r1
 }
 #endif /* ENABLE_DP64_SUPPORT */
 
+/* Removes the packets that directly follow pkt in the packet queue and
+ * are of the same type for the same file handle, so that they can be
+ * handled with pkt in one go. Returns the number of packets in pkts.
+ */
+static int FbxGetMergeablePackets(struct FbxFS *fs, struct DosPacket *pkt,
+	struct DosPacket **pkts, SIPTR *total)
+{
+	struct Library *SysBase = fs->sysbase;
+	struct Message *msg;
+	struct DosPacket *pkt2;
+	int n = 1;
+
+	pkts[0] = pkt;
+	*total = pkt->dp_Arg3;
+	if (*total <= 0 || *total >= MERGEMAXBYTES)
+		return n;
+
+	Forbid();
+	while (n < MERGEMAXPACKETS) {
+		msg = (struct Message *)fs->fsport->mp_MsgList.lh_Head;
+		if (msg->mn_Node.ln_Succ == NULL)
+			break;
+
+		pkt2 = (struct DosPacket *)msg->mn_Node.ln_Name;
+		if (pkt2->dp_Type != pkt->dp_Type || pkt2->dp_Arg1 != pkt->dp_Arg1 ||
+			pkt2->dp_Arg3 <= 0 || (*total + pkt2->dp_Arg3) > MERGEMAXBYTES)
+		{
+			break;
+		}
+
+		Remove(&msg->mn_Node);
+		pkts[n++] = pkt2;
+		*total += pkt2->dp_Arg3;
+	}
+	Permit();
+
+	return n;
+}
+
+/* Handles consecutive ACTION_READ or ACTION_WRITE packets for the same file
+ * handle with a single read or write of their combined size. Reads go
+ * through a temporary buffer, while the buffers of the write packets are
+ * passed on as the segments of a single vector. Each packet is replied in
+ * order with its own part of the result. Whatever can't be handled that
+ * way, because of a short read or write, is done packet by packet as
+ * usual. An error, for instance one from an earlier deferred write, is
+ * returned with the first packet only.
+ */
+static void FbxHandleMergedPackets(struct FbxFS *fs, struct DosPacket **pkts, int n, SIPTR total) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxLock *lock = (struct FbxLock *)BADDR(pkts[0]->dp_Arg1);
+	struct FbxBufVec bufv;
+	UBYTE *buffer = NULL;
+	SIPTR res = -1, offs, len;
+	QUAD start = 0;
+	BOOL done = FALSE;
+	int i;
+
+	if (FbxCheckLock(fs, lock))
+		start = lock->filepos;
+
+	if (pkts[0]->dp_Type == ACTION_READ) {
+		buffer = AllocVecPooled(fs->mempool, total);
+		if (buffer != NULL) {
+			res = FbxReadFile(fs, lock, buffer, total);
+			done = TRUE;
+		}
+	} else {
+		for (i = 0; i < n; i++) {
+			bufv.bv.buf[i].size = pkts[i]->dp_Arg3;
+			bufv.bv.buf[i].mem  = (void *)pkts[i]->dp_Arg2;
+		}
+		bufv.bv.count = n;
+		res = FbxWriteFileVec(fs, lock, &bufv.bv, total);
+		done = TRUE;
+	}
+
+	i = 0;
+	if (done && res < 0) {
+		FbxReturnPacket(fs, pkts[i++], -1, fs->r2);
+	} else if (res >= 0) {
+		// the packets that are done one by one continue after the part
+		// that was actually read or written
+		if (res < total)
+			lock->filepos = start + res;
+
+		for (offs = 0; i < n; i++) {
+			len = min(pkts[i]->dp_Arg3, res - offs);
+			if (pkts[i]->dp_Type == ACTION_READ)
+				CopyMem(buffer + offs, (APTR)pkts[i]->dp_Arg2, len);
+			offs += len;
+			if (len < pkts[i]->dp_Arg3) {
+				// the rest is done packet by packet
+				FbxReturnPacket(fs, pkts[i++], len, fs->r2);
+				break;
+			}
+			FbxReturnPacket(fs, pkts[i], len, 0);
+		}
+	}
+
+	if (buffer != NULL)
+		FreeVecPooled(fs->mempool, buffer);
+
+	for (; i < n; i++) {
+		SIPTR r1 = FbxDoPacket(fs, pkts[i]);
+		FbxReturnPacket(fs, pkts[i], r1, fs->r2);
+	}
+}
+
 static void FbxHandlePackets(struct FbxFS *fs) {
 	struct Library *SysBase = fs->sysbase;
 	struct Message *msg;
 	struct DosPacket *pkt;
+	struct DosPacket *pkts[MERGEMAXPACKETS];
+	SIPTR total;
+	int n;
 
 	DEBUGF("FbxHandlePackets(%p)\n", fs);
 
@@ -204,6 +329,12 @@ static void FbxHandlePackets(struct FbxFS *fs) {
 		}
 		else
 #endif /* ENABLE_DP64_SUPPORT */
+		if ((pkt->dp_Type == ACTION_READ || pkt->dp_Type == ACTION_WRITE) &&
+			(n = FbxGetMergeablePackets(fs, pkt, pkts, &total)) > 1)
+		{
+			FbxHandleMergedPackets(fs, pkts, n, total);
+		}
+		else
 		{
 			SIPTR r1 = FbxDoPacket(fs, pkt);
 			FbxReturnPacket(fs, pkt, r1, fs->r2);
@@ -231,6 +362,36 @@ static void FbxHandleNotifyReplies(struct FbxFS *fs) {
 	}
 }
 
+/* Updates the average write rate once every WRITE_RATE_INTERVAL_MILLIS */
+static void FbxUpdateWriteRate(struct FbxFS *fs) {
+	ULONG currtime = FbxGetUpTimeMillis(fs);
+	ULONG elapsed = currtime - fs->ratetime;
+	ULONG rate;
+
+	if (elapsed < WRITE_RATE_INTERVAL_MILLIS)
+		return;
+
+	rate = (ULONG)min((UQUAD)fs->ratebytes * 1000 / elapsed, 0xFFFFFFFFULL);
+	fs->writerate = (ULONG)(((UQUAD)fs->writerate * 3 + rate) / 4);
+	fs->ratebytes = 0;
+	fs->ratetime  = currtime;
+}
+
+/* Returns how long modifications must have stopped before flushing. This
+ * is normally the inactive update timeout, but files that are written to
+ * a little at a time would then be flushed after every write, so it is
+ * made longer than the usual time between their writes. The active update
+ * timeout still makes sure that their data gets flushed.
+ */
+static LONG FbxIdleTimeout(struct FbxFS *fs) {
+	ULONG timeout = max(fs->iaut, fs->modifygap * 2);
+
+	if (fs->aut != 0 && timeout > fs->aut)
+		timeout = fs->aut;
+
+	return (LONG)timeout;
+}
+
 static void FbxHandleTimerEvent(struct FbxFS *fs) {
 	struct Library *SysBase = fs->sysbase;
 	struct Message *msg;
@@ -271,16 +432,23 @@ static void FbxHandleTimerEvent(struct FbxFS *fs) {
 			ReleaseSemaphore(&fs->fssema);
 		}
 
-		if (fs->aut != 0 || fs->iaut != 0) {
+		if (fs->aut != 0 || fs->iaut != 0 || fs->dirtylimit != 0) {
 			ObtainSemaphore(&fs->fssema);
 
+			FbxUpdateWriteRate(fs);
+
 			if (OKVOLUME(fs->currvol) && fs->firstmodify) {
 				ULONG currtime = FbxGetUpTimeMillis(fs);
 				LONG x = (LONG)(currtime - fs->firstmodify);
 				LONG y = (LONG)(currtime - fs->lastmodify);
-				if (fs->aut != 0 && x > fs->aut) {
+				if (fs->dirtylimit != 0 && fs->dirtybytes >= fs->dirtylimit) {
+					fs->thresholdflushes++;
+					FbxFlushAll(fs);
+				} else if (fs->aut != 0 && x > fs->aut) {
+					fs->ageflushes++;
 					FbxFlushAll(fs);
-				} else if (fs->iaut != 0 && y > fs->iaut) {
+				} else if (fs->iaut != 0 && y > FbxIdleTimeout(fs)) {
+					fs->idleflushes++;
 					FbxFlushAll(fs);
 				}
 			}
@@ -50,12 +50,53 @@
 *       FBXT_INACTIVE_UPDATE_TIMEOUT (ULONG)
 *           Inactive update timeout in milliseconds.
 *
+*       FBXT_NEGATIVE_LOOKUP_TIMEOUT (ULONG) (V54)
+*           Negative lookup cache timeout in milliseconds.
+*
+*       FBXT_ATTR_TIMEOUT (ULONG) (V54)
+*           Attribute cache timeout in milliseconds.
+*
+*       FBXT_READ_BUFFER_SIZE (ULONG) (V54)
+*           Per handle read buffer size in bytes.
+*
+*       FBXT_WRITE_BUFFER_SIZE (ULONG) (V54)
+*           Per handle write buffer size in bytes.
+*
+*       FBXT_BLOCK_CACHE_SIZE (ULONG) (V54)
+*           Block cache size in bytes.
+*
+*       FBXT_READAHEAD_SIZE (ULONG) (V54)
+*           Maximum readahead window size in bytes.
+*
+*       FBXT_DIRTY_LIMIT (ULONG) (V54)
+*           Amount of written data in bytes that causes a flush.
+*
+*       FBXT_DIR_CACHE_SIZE (ULONG) (V54)
+*           Directory cache size in bytes.
+*
 *       FBXT_GMT_OFFSET (LONG)
 *           Returns a cached TZA_UTCOffset value. Its updated periodically
 *           in case it changes because of a locale prefs change or because
 *           of DST state change. Using GetTimezoneAttrs() directly from
 *           any of the FUSE callbacks is not safe and can cause deadlocks.
 *
+*       FBXT_DIRTY_BYTES (ULONG) (V54)
+*           Bytes written since the last flush.
+*
+*       FBXT_WRITE_RATE (ULONG) (V54)
+*           Average write rate in bytes per second, updated every second.
+*
+*       FBXT_THRESHOLD_FLUSHES (ULONG) (V54)
+*           Number of flushes done because FBXT_DIRTY_LIMIT was reached.
+*
+*       FBXT_AGE_FLUSHES (ULONG) (V54)
+*           Number of flushes done because FBXT_ACTIVE_UPDATE_TIMEOUT had
+*           passed since the first modification.
+*
+*       FBXT_IDLE_FLUSHES (ULONG) (V54)
+*           Number of flushes done because no modifications had been made
+*           for the inactive update timeout.
+*
 *   RESULT
 *       This function does not return a result
 *
@@ -118,9 +159,61 @@ void FbxQueryFS(
 				*(ULONG *)tag->ti_Data = fs->iaut;
 				break;
 
+			case FBXT_NEGATIVE_LOOKUP_TIMEOUT:
+				*(ULONG *)tag->ti_Data = fs->negtimeout;
+				break;
+
+			case FBXT_ATTR_TIMEOUT:
+				*(ULONG *)tag->ti_Data = fs->attrtimeout;
+				break;
+
+			case FBXT_READ_BUFFER_SIZE:
+				*(ULONG *)tag->ti_Data = fs->rbufsize;
+				break;
+
+			case FBXT_WRITE_BUFFER_SIZE:
+				*(ULONG *)tag->ti_Data = fs->wbufsize;
+				break;
+
+			case FBXT_BLOCK_CACHE_SIZE:
+				*(ULONG *)tag->ti_Data = fs->bcachesize;
+				break;
+
+			case FBXT_READAHEAD_SIZE:
+				*(ULONG *)tag->ti_Data = fs->rasize;
+				break;
+
+			case FBXT_DIRTY_LIMIT:
+				*(ULONG *)tag->ti_Data = fs->dirtylimit;
+				break;
+
+			case FBXT_DIR_CACHE_SIZE:
+				*(ULONG *)tag->ti_Data = fs->dcachesize;
+				break;
+
 			case FBXT_GMT_OFFSET:
 				*(LONG *)tag->ti_Data = fs->gmtoffset;
 				break;
+
+			case FBXT_DIRTY_BYTES:
+				*(ULONG *)tag->ti_Data = fs->dirtybytes;
+				break;
+
+			case FBXT_WRITE_RATE:
+				*(ULONG *)tag->ti_Data = fs->writerate;
+				break;
+
+			case FBXT_THRESHOLD_FLUSHES:
+				*(ULONG *)tag->ti_Data = fs->thresholdflushes;
+				break;
+
+			case FBXT_AGE_FLUSHES:
+				*(ULONG *)tag->ti_Data = fs->ageflushes;
+				break;
+
+			case FBXT_IDLE_FLUSHES:
+				*(ULONG *)tag->ti_Data = fs->idleflushes;
+				break;
 		}
 	}
 
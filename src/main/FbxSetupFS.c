@@ -59,6 +59,22 @@
 *               path string and use this instead of st_ino for the
 *               ObjectID.
 *
+*           FBXF_SYNC_ROOT (V54)
+*               Makes filesysbox flush the filesystem with a single
+*               fsync("/") call, like older versions did. By default
+*               files that are still open when the filesystem is flushed
+*               are committed with fsync() on their own handles, and a
+*               single fsync("/") is used for all other changes.
+*
+*           FBXF_SYNC_PATHS (V54)
+*               Indicates that fsync() with a NULL fuse_file_info can
+*               commit a single object given by its path, and not only the
+*               whole filesystem with "/". Files that have been closed
+*               before the flush, and the directories that files have been
+*               created in, are then committed with fsync() on their paths,
+*               so that fsync("/") is only used when other changes have
+*               been made.
+*
 *       FBXT_FSSM (struct FileSysStartupMsg *)
 *           Overrides the one in msg.
 *           A NULL fssm is OK and will disable ACTION_GET_DISK_FSSM.
@@ -79,7 +95,78 @@
 *
 *       FBXT_INACTIVE_UPDATE_TIMEOUT (ULONG)
 *           Inactive update timeout in milliseconds. Defaults to 500.
-*           Setting this timeout to zero disables it.
+*           Setting this timeout to zero disables it. If the time between
+*           modifications has been longer than half of this timeout on
+*           average, twice that average is used instead, up to the active
+*           update timeout.
+*
+*       FBXT_NEGATIVE_LOOKUP_TIMEOUT (ULONG) (V54)
+*           Time in milliseconds for which a failed lookup of an object
+*           that does not exist is remembered, so that repeated lookups
+*           don't need to call getattr() again. Objects created through
+*           filesysbox are never affected, but objects created behind its
+*           back may not be seen until the timeout expires. Defaults to 0
+*           which disables the negative lookup cache.
+*
+*       FBXT_ATTR_TIMEOUT (ULONG) (V54)
+*           Time in milliseconds for which the attributes returned by
+*           getattr() or fgetattr() for a locked object are cached.
+*           Changes made through filesysbox invalidate the cached
+*           attributes, so this timeout only limits how long changes made
+*           behind its back may go unnoticed. Defaults to 0 which disables
+*           the attribute cache. Setting it to FBX_TIMEOUT_INFINITE makes
+*           cached attributes never expire on read-only volumes, while
+*           writable volumes use a timeout of 1000 ms.
+*
+*       FBXT_READ_BUFFER_SIZE (ULONG) (V54)
+*           Size in bytes of the read buffer allocated for each file handle
+*           on its first read that is smaller than the buffer. Such reads
+*           are then served from the buffer, which is refilled with a single
+*           read() call of this size. Handles opened with direct_io set are
+*           never buffered. Defaults to 0 which disables read buffering.
+*
+*       FBXT_WRITE_BUFFER_SIZE (ULONG) (V54)
+*           Size in bytes of the write buffer allocated for each file handle
+*           on its first write that is smaller than the buffer. Contiguous
+*           small writes are collected in the buffer and written with a
+*           single write() call when it is full, or on seek, close,
+*           SetFileSize(), ACTION_FLUSH and the update timeouts. Errors
+*           from such deferred writes are reported by the next operation
+*           on the file handle, or by Close(). Handles opened with direct_io
+*           set are never buffered. Defaults to 0 which disables write
+*           buffering.
+*
+*       FBXT_BLOCK_CACHE_SIZE (ULONG) (V54)
+*           Size in bytes of a cache of file data that is shared by all
+*           handles to the same file and kept after they are closed. Files
+*           are identified by st_ino, so the cache is only used together
+*           with FBXF_USE_INO. The cached data of a file is dropped when it
+*           is opened, unless the filesystem sets keep_cache in the
+*           fuse_file_info, and handles opened with direct_io set bypass
+*           the cache. Defaults to 0 which disables the cache.
+*
+*       FBXT_READAHEAD_SIZE (ULONG) (V54)
+*           Maximum size in bytes of the readahead window of file handles
+*           that are read sequentially. The window is filled by the event
+*           loop while no packets are waiting, and its size is doubled each
+*           time it is filled until this size is reached. Handles opened
+*           with direct_io set are never read ahead. Defaults to 0 which
+*           disables readahead.
+*
+*       FBXT_DIRTY_LIMIT (ULONG) (V54)
+*           Amount of data in bytes that may be written before the
+*           filesystem is flushed without waiting for the update
+*           timeouts. Defaults to 0 which disables the limit.
+*
+*       FBXT_DIR_CACHE_SIZE (ULONG) (V54)
+*           Size in bytes of a cache of complete directory listings,
+*           including the stat data, protection flags and comment of each
+*           entry, so that scanning an unchanged directory again with
+*           ExNext() or ExAll() doesn't call the filesystem at all. Changes
+*           made through filesysbox invalidate the affected listings, and
+*           the least recently used ones are dropped when the cache is
+*           full. Changes made behind the back of filesysbox are not seen.
+*           Defaults to 0 which disables the cache.
 *
 *   RESULT
 *       A filesystem handle or NULL if setup failed.
@@ -176,6 +263,14 @@ struct FbxFS *FbxSetupFS(
 
 	fs->aut = ACTIVE_UPDATE_TIMEOUT_MILLIS;
 	fs->iaut = INACTIVE_UPDATE_TIMEOUT_MILLIS;
+	fs->negtimeout = 0;
+	fs->attrtimeout = 0;
+	fs->rbufsize = 0;
+	fs->wbufsize = 0;
+	fs->bcachesize = 0;
+	fs->rasize = 0;
+	fs->dirtylimit = 0;
+	fs->dcachesize = 0;
 
 	NEWMINLIST(&fs->volumelist);
 	NEWMINLIST(&fs->timercallbacklist);
@@ -296,6 +391,30 @@ struct FbxFS *FbxSetupFS(
 		case FBXT_INACTIVE_UPDATE_TIMEOUT:
 			fs->iaut = tag->ti_Data;
 			break;
+		case FBXT_NEGATIVE_LOOKUP_TIMEOUT:
+			fs->negtimeout = tag->ti_Data;
+			break;
+		case FBXT_ATTR_TIMEOUT:
+			fs->attrtimeout = tag->ti_Data;
+			break;
+		case FBXT_READ_BUFFER_SIZE:
+			fs->rbufsize = tag->ti_Data;
+			break;
+		case FBXT_WRITE_BUFFER_SIZE:
+			fs->wbufsize = tag->ti_Data;
+			break;
+		case FBXT_BLOCK_CACHE_SIZE:
+			fs->bcachesize = tag->ti_Data;
+			break;
+		case FBXT_READAHEAD_SIZE:
+			fs->rasize = tag->ti_Data;
+			break;
+		case FBXT_DIRTY_LIMIT:
+			fs->dirtylimit = tag->ti_Data;
+			break;
+		case FBXT_DIR_CACHE_SIZE:
+			fs->dcachesize = tag->ti_Data;
+			break;
 		}
 	}
 
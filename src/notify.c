@@ -61,11 +61,14 @@ void FbxDoNotify(struct FbxFS *fs, const char *path) {
 	NDEBUGF("FbxDoNotify(%p, '%s')\n", fs, path);
 
 	FbxStrlcpy(fs, pathbuf, path, FBX_MAX_PATH);
-	do {
-		e = FbxFindEntry(fs, pathbuf);
-		if (e != NULL) FbxDoNotifyEntry(fs, e);
+	e = FbxFindClosestEntry(fs, pathbuf);
+	while (e != NULL) {
+		// the object or its contents have changed
+		FbxInvalidateEntryAttr(fs, e);
+		FbxDoNotifyEntry(fs, e);
 		// parent dirs wants notify too
-	} while (FbxParentPath(fs, pathbuf));
+		e = e->parent;
+	}
 }
 
 void FbxTryResolveNotify(struct FbxFS *fs, struct FbxEntry *e) {
@@ -0,0 +1,170 @@
+/*
+ * Filesysbox filesystem layer/framework
+ *
+ * Copyright (c) 2008-2011 Leif Salomonsson [dev blubbedev net]
+ * Copyright (c) 2013-2026 Fredrik Wikstrom [fredrik a500 org]
+ *
+ * This library is released under AROS PUBLIC LICENSE 1.1
+ * See the file LICENSE.APL
+ */
+
+#include "filesysbox_internal.h"
+#include "fuse_stubs.h"
+#include <errno.h>
+#include <string.h>
+
+/* A path cache is a small hash table of full paths with a LRU list. When
+ * the maximum number of nodes is reached the least recently used one is
+ * replaced. Nodes also remember the hash of their parent directory path
+ * so that all nodes in a directory can be invalidated at once.
+ */
+
+void FbxInitPathCache(struct FbxPathCache *pc, ULONG maxcount) {
+	int i;
+
+	for (i = 0; i < PATHCACHEHASHSIZE; i++) {
+		NEWMINLIST(&pc->hashtab[i]);
+	}
+	NEWMINLIST(&pc->lrulist);
+	pc->count    = 0;
+	pc->maxcount = maxcount;
+}
+
+static ULONG FbxHashParentPath(struct FbxFS *fs, const char *path) {
+	char pathbuf[FBX_MAX_PATH];
+
+	FbxStrlcpy(fs, pathbuf, path, FBX_MAX_PATH);
+	FbxParentPath(fs, pathbuf);
+	return FbxHashPath(fs, pathbuf);
+}
+
+struct FbxPathNode *FbxFindPathNode(struct FbxFS *fs, struct FbxPathCache *pc, const char *path) {
+	struct Library *SysBase = fs->sysbase;
+	struct MinNode *chain, *succ;
+	struct FbxPathNode *pn;
+	ULONG hash;
+
+	if (pc->count == 0)
+		return NULL;
+
+	hash = FbxHashPath(fs, path);
+	for (chain = pc->hashtab[hash % PATHCACHEHASHSIZE].mlh_Head;
+	     (succ = chain->mln_Succ) != NULL;
+	     chain = succ)
+	{
+		pn = FSPATHNODEFROMHASHCHAIN(chain);
+		if (pn->hash == hash && FbxStrcmp(fs, pn->path, path) == 0) {
+			// move to end of LRU list
+			Remove((struct Node *)&pn->lruchain);
+			AddTail((struct List *)&pc->lrulist, (struct Node *)&pn->lruchain);
+			return pn;
+		}
+	}
+
+	return NULL;
+}
+
+void FbxRemovePathNode(struct FbxFS *fs, struct FbxPathCache *pc, struct FbxPathNode *pn) {
+	struct Library *SysBase = fs->sysbase;
+
+	Remove((struct Node *)&pn->hashchain);
+	Remove((struct Node *)&pn->lruchain);
+	FreeVecPooled(fs->mempool, pn);
+	pc->count--;
+}
+
+struct FbxPathNode *FbxAddPathNode(struct FbxFS *fs, struct FbxPathCache *pc, const char *path) {
+	struct Library *SysBase = fs->sysbase;
+	struct FbxPathNode *pn;
+	size_t size;
+
+	pn = FbxFindPathNode(fs, pc, path);
+	if (pn == NULL) {
+		if (pc->maxcount == 0)
+			return NULL;
+
+		if (pc->count >= pc->maxcount) {
+			pn = FSPATHNODEFROMLRUCHAIN(pc->lrulist.mlh_Head);
+			FbxRemovePathNode(fs, pc, pn);
+		}
+
+		size = min(strlen(path) + 1, FBX_MAX_PATH);
+		pn = AllocVecPooled(fs->mempool, sizeof(*pn) + size);
+		if (pn == NULL)
+			return NULL;
+
+		FbxStrlcpy(fs, pn->path, path, size);
+		pn->hash    = FbxHashPath(fs, pn->path);
+		pn->dirhash = FbxHashParentPath(fs, pn->path);
+
+		AddTail((struct List *)&pc->hashtab[pn->hash % PATHCACHEHASHSIZE], (struct Node *)&pn->hashchain);
+		AddTail((struct List *)&pc->lrulist, (struct Node *)&pn->lruchain);
+		pc->count++;
+	}
+
+	pn->time = FbxGetUpTimeMillis(fs);
+	return pn;
+}
+
+/* Removes all nodes for objects inside the parent directory of path */
+void FbxInvalidatePathDir(struct FbxFS *fs, struct FbxPathCache *pc, const char *path) {
+	struct MinNode *chain, *succ;
+	struct FbxPathNode *pn;
+	ULONG dirhash;
+
+	if (pc->count == 0)
+		return;
+
+	dirhash = FbxHashParentPath(fs, path);
+	for (chain = pc->lrulist.mlh_Head;
+	     (succ = chain->mln_Succ) != NULL;
+	     chain = succ)
+	{
+		pn = FSPATHNODEFROMLRUCHAIN(chain);
+		if (pn->dirhash == dirhash) {
+			FbxRemovePathNode(fs, pc, pn);
+		}
+	}
+}
+
+void FbxFlushPathCache(struct FbxFS *fs, struct FbxPathCache *pc) {
+	struct MinNode *chain;
+
+	while ((chain = pc->lrulist.mlh_Head)->mln_Succ != NULL) {
+		FbxRemovePathNode(fs, pc, FSPATHNODEFROMLRUCHAIN(chain));
+	}
+}
+
+/* Negative lookup cache. Remembers paths for which getattr() returned
+ * -ENOENT for fs->negtimeout milliseconds so that repeated probes for
+ * objects that don't exist don't each need a call to the file system.
+ */
+
+int FbxCachedGetAttr(struct FbxFS *fs, const char *path, struct fbx_stat *stat) {
+	struct FbxPathCache *pc = &fs->currvol->negcache;
+	struct FbxPathNode *pn;
+	int error;
+
+	if (fs->negtimeout != 0) {
+		pn = FbxFindPathNode(fs, pc, path);
+		if (pn != NULL) {
+			if ((FbxGetUpTimeMillis(fs) - pn->time) < fs->negtimeout) {
+				DEBUGF("FbxCachedGetAttr: '%s' is in negative cache\n", path);
+				return -ENOENT;
+			}
+			FbxRemovePathNode(fs, pc, pn);
+		}
+	}
+
+	error = Fbx_getattr(fs, path, stat);
+	if (error == -ENOENT && fs->negtimeout != 0) {
+		FbxAddPathNode(fs, pc, path);
+	}
+
+	return error;
+}
+
+/* Must be called after an object has been created at path */
+void FbxInvalidateNegative(struct FbxFS *fs, const char *path) {
+	FbxInvalidatePathDir(fs, &fs->currvol->negcache, path);
+}
@@ -53,7 +53,7 @@ struct FbxVolume *FbxSetupVolume(struct FbxFS *fs) {
 #endif
 	struct fuse_conn_info *conn = &fs->conn;
 	APTR initret;
-	int error, i, rc;
+	int error, rc;
 	struct FbxVolume *vol;
 	struct statvfs st;
 	struct fbx_stat statbuf;
@@ -141,12 +141,24 @@ struct FbxVolume *FbxSetupVolume(struct FbxFS *fs) {
 	vol->writeprotect = FALSE;
 	vol->vflags       = 0;
 	vol->blocksize    = st.f_frsize;
+	vol->metadirty    = FALSE;
 
 	NEWMINLIST(&vol->unres_notifys);
 	NEWMINLIST(&vol->locklist);
 	NEWMINLIST(&vol->notifylist);
-	for (i = 0; i < ENTRYHASHSIZE; i++) {
-		NEWMINLIST(&vol->entrytab[i]);
+	NEWMINLIST(&vol->ralist);
+
+	FbxInitPathCache(&vol->negcache, NEGCACHEMAXENTRIES);
+	FbxInitPathCache(&vol->archpending, ARCHPENDINGMAXENTRIES);
+	FbxInitPathCache(&vol->archcleared, ARCHCLEAREDMAXENTRIES);
+	FbxInitPathCache(&vol->dirtypaths, DIRTYPATHSMAXENTRIES);
+	FbxInitBlockCache(&vol->blockcache, fs->bcachesize / BLOCKCACHEBLOCKSIZE);
+	FbxInitDirCache(&vol->dircache, fs->dcachesize);
+
+	if (!FbxSetupEntryTable(fs, vol)) {
+		Fbx_destroy(fs, fs->initret);
+		FreeFbxVolume(vol);
+		return NULL;
 	}
 
 	if (st.f_flag & ST_CASE_SENSITIVE) {
@@ -162,6 +174,7 @@ struct FbxVolume *FbxSetupVolume(struct FbxFS *fs) {
 	if (!rc) {
 		DEBUGF("FbxSetupVolume: NBM_ADDDOSENTRY failed (name collision ?) err %d\n", (int)IoErr());
 		Fbx_destroy(fs, fs->initret);
+		FbxCleanupEntryTable(fs, vol);
 		FreeFbxVolume(vol);
 		return NULL;
 	}
@@ -194,13 +207,20 @@ void FbxCleanupVolume(struct FbxFS *fs) {
 		return;
 	}
 
+	// write out buffered data while the files are still open
+	FbxFlushAllWriteBuffers(fs);
+
 	struct MinNode *chain, *succ;
 	chain = vol->locklist.mlh_Head;
 	while ((succ = chain->mln_Succ) != NULL) {
 		struct FbxLock *lock = FSLOCKFROMVOLUMECHAIN(chain);
 
+		FbxCancelReadahead(fs, lock);
+		FbxEndReadDir(fs, lock);
+
 		if (lock->info != NULL) {
 			struct FbxEntry *e = lock->entry;
+			FbxTrimPreallocation(fs, lock);
 			Fbx_release(fs, e->path, lock->info);
 			FreeFuseFileInfo(fs, lock->info);
 			lock->info = NULL;
@@ -214,6 +234,15 @@ void FbxCleanupVolume(struct FbxFS *fs) {
 
 	Fbx_destroy(fs, fs->initret);
 
+	// entries of old volumes are never looked up again
+	FbxCleanupEntryTable(fs, vol);
+	FbxFlushPathCache(fs, &vol->negcache);
+	FbxFlushPathCache(fs, &vol->archpending);
+	FbxFlushPathCache(fs, &vol->archcleared);
+	FbxFlushPathCache(fs, &vol->dirtypaths);
+	FbxFlushBlockCache(fs, &vol->blockcache);
+	FbxFlushDirCache(fs, &vol->dircache);
+
 	if (IsMinListEmpty(&vol->locklist) &&
 		IsMinListEmpty(&vol->notifylist))
 	{
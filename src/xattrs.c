@@ -11,12 +11,68 @@
 #include "filesysbox_internal.h"
 #include "fuse_stubs.h"
 #include <errno.h>
+#include <string.h>
 
 #ifndef ENODATA
 #define ENODATA ENOENT
 #endif
 
-ULONG FbxGetAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath) {
+#define AXF_PROTECTION 1
+#define AXF_COMMENT    2
+
+static int Fbx_listxattr(struct FbxFS *fs, const char *path, char *buf, size_t len)
+{
+	ODEBUGF("Fbx_listxattr(%p, '%s', %p, %zu)\n", fs, path, buf, len);
+
+	return FSOP listxattr(path, buf, len, &fs->fcntx);
+}
+
+/* Uses listxattr() to find out which of the amiga xattrs an object has.
+ * Returns -1 if the file system can't tell.
+ */
+static int FbxListAmigaXattrs(struct FbxFS *fs, const char *fullpath) {
+	char buffer[256];
+	const char *name, *end;
+	int res, flags = 0;
+
+	if (FSOP listxattr == NULL)
+		return -1;
+
+	res = Fbx_listxattr(fs, fullpath, buffer, sizeof(buffer));
+	if (res == -ENOSYS || res == -EOPNOTSUPP) {
+		// not supported, so never call it again (fs->ops is our own copy)
+		FSOP listxattr = NULL;
+		return -1;
+	}
+	if (res < 0 || (size_t)res > sizeof(buffer))
+		return -1;
+
+	name = buffer;
+	end = buffer + res;
+	while (name < end) {
+		if (memchr(name, '\0', end - name) == NULL)
+			return -1;
+
+		if (strcmp(name, fs->xattr_amiga_protection) == 0)
+			flags |= AXF_PROTECTION;
+		else if (strcmp(name, fs->xattr_amiga_comment) == 0)
+			flags |= AXF_COMMENT;
+
+		name += strlen(name) + 1;
+	}
+
+	return flags;
+}
+
+static int Fbx_getamigaattr(struct FbxFS *fs, const char *path, struct fbx_stat *stat,
+	ULONG *prot, char *comment, size_t size)
+{
+	ODEBUGF("Fbx_getamigaattr(%p, '%s', %p, %p, %p, %zu)\n", fs, path, stat, prot, comment, size);
+
+	return FSOP getamigaattr(path, stat, prot, comment, size, &fs->fcntx);
+}
+
+static ULONG FbxReadAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath) {
 	char buffer[4];
 	int res, i;
 	ULONG prot = 0;
@@ -52,10 +108,12 @@ int FbxSetAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath, ULONG pro
 			error = 0;
 	}
 
+	FbxInvalidatePathXattrs(fs, fullpath);
+
 	return error;
 }
 
-void FbxGetComment(struct FbxFS *fs, const char *fullpath, char *comment, size_t size) {
+static void FbxReadComment(struct FbxFS *fs, const char *fullpath, char *comment, size_t size) {
 	int res;
 
 	res = Fbx_getxattr(fs, fullpath, fs->xattr_amiga_comment, comment, size-1);
@@ -71,3 +129,104 @@ void FbxGetComment(struct FbxFS *fs, const char *fullpath, char *comment, size_t
 	}
 }
 
+
+/* Gets the amiga protection flags and, if comment is not NULL, the comment
+ * of an object. Both are cached together in the entry of the object if it
+ * has one.
+ */
+void FbxGetAmigaAttrs(struct FbxFS *fs, const char *fullpath, ULONG *prot, char *comment, size_t size) {
+	struct FbxEntry *e;
+	char fscomment[FBX_MAX_COMMENT];
+	int want, have;
+
+	e = FbxFindEntry(fs, fullpath);
+	if (e != NULL && FbxGetEntryXattrs(fs, e, prot, comment, size))
+		return;
+
+	want = AXF_PROTECTION;
+	if (comment != NULL || e != NULL)
+		want |= AXF_COMMENT;
+
+	// listing only saves calls if both xattrs are wanted
+	have = -1;
+	if (want == (AXF_PROTECTION|AXF_COMMENT))
+		have = FbxListAmigaXattrs(fs, fullpath);
+	if (have == -1)
+		have = AXF_PROTECTION|AXF_COMMENT;
+
+	*prot = 0;
+	if (want & have & AXF_PROTECTION)
+		*prot = FbxReadAmigaProtectionFlags(fs, fullpath);
+
+	fscomment[0] = '\0';
+	if (want & have & AXF_COMMENT)
+		FbxReadComment(fs, fullpath, fscomment, sizeof(fscomment));
+
+	if (e != NULL)
+		FbxSetEntryXattrs(fs, e, *prot, fscomment);
+
+	if (comment != NULL)
+		FbxStrlcpy(fs, comment, fscomment, size);
+}
+
+ULONG FbxGetAmigaProtectionFlags(struct FbxFS *fs, const char *fullpath) {
+	ULONG prot;
+
+	FbxGetAmigaAttrs(fs, fullpath, &prot, NULL, 0);
+	return prot;
+}
+
+void FbxGetComment(struct FbxFS *fs, const char *fullpath, char *comment, size_t size) {
+	ULONG prot;
+
+	FbxGetAmigaAttrs(fs, fullpath, &prot, comment, size);
+}
+
+/* Gets the stat data, amiga protection flags and, if comment is not NULL,
+ * the comment of an object. If the file system implements getamigaattr()
+ * they are all fetched with a single call.
+ */
+int FbxGetAmigaStat(struct FbxFS *fs, const char *fullpath, struct fbx_stat *stat,
+	ULONG *prot, char *comment, size_t size)
+{
+	struct FbxEntry *e;
+	char fscomment[FBX_MAX_COMMENT];
+	int error;
+
+	if (FSOP getamigaattr != NULL) {
+		e = FbxFindEntry(fs, fullpath);
+		if (e == NULL || !FbxEntryAttrsCached(fs, e)) {
+			if (e != NULL)
+				FbxFlushWriteBuffers(fs, e);
+
+			*prot = 0;
+			fscomment[0] = '\0';
+			error = Fbx_getamigaattr(fs, fullpath, stat, prot, fscomment, sizeof(fscomment));
+			if (error != -ENOSYS) {
+				if (error)
+					return error;
+
+				*prot &= (FIBF_HOLD|FIBF_SCRIPT|FIBF_PURE|FIBF_ARCHIVE);
+				fscomment[sizeof(fscomment) - 1] = '\0';
+				if (!FbxCheckString(fs, fscomment))
+					fscomment[0] = '\0';
+
+				if (e != NULL) {
+					FbxSetEntryAttr(fs, e, stat);
+					FbxSetEntryXattrs(fs, e, *prot, fscomment);
+				}
+
+				if (comment != NULL)
+					FbxStrlcpy(fs, comment, fscomment, size);
+				return 0;
+			}
+		}
+	}
+
+	error = FbxGetPathAttr(fs, fullpath, stat);
+	if (error)
+		return error;
+
+	FbxGetAmigaAttrs(fs, fullpath, prot, comment, size);
+	return 0;
+}